@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "AssetLoader.h"
+#include <algorithm>
+#include <memory>
+
+AssetLoader::AssetLoader(unsigned numThreads)
+    : mutex_(),
+    hasWork_(),
+    jobs_(),
+    stopping_(false),
+    threads_()
+{
+    if (numThreads == 0) {
+        // hardware_concurrency() is allowed to return 0 if it doesn't know.
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (auto i = 0u; i < numThreads; ++i) {
+        threads_.emplace_back([this] { run(); });
+    }
+}
+
+AssetLoader::~AssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    hasWork_.notify_all();
+    for (auto &t : threads_) {
+        t.join();
+    }
+}
+
+std::future<SdlPixelBuffer> AssetLoader::loadImage(const std::string &filename)
+{
+    return submit<SdlPixelBuffer>([filename] {
+        return sdlDecodeImage(filename.c_str());
+    });
+}
+
+std::future<SdlSound> AssetLoader::loadSound(const std::string &filename)
+{
+    return submit<SdlSound>([filename] {
+        return sdlLoadSound(filename.c_str());
+    });
+}
+
+template <typename T>
+std::future<T> AssetLoader::submit(std::function<T ()> job)
+{
+    // std::function has to be copyable, packaged_task isn't.
+    auto task = std::make_shared<std::packaged_task<T ()>>(std::move(job));
+    auto result = task->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.emplace_back([task] { (*task)(); });
+    }
+    hasWork_.notify_one();
+    return result;
+}
+
+void AssetLoader::run()
+{
+    for (;;) {
+        std::function<void ()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            hasWork_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;  // stopping and nothing left to do
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
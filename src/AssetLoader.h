@@ -0,0 +1,57 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include "sdl_helper.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decode images and sounds on a pool of worker threads.  Each request returns
+// a future right away.  Images come back as pixel buffers because only the
+// main thread can touch the display; turn them into surfaces with
+// sdlDisplayFormat().  Sounds are ready to play as-is.
+class AssetLoader
+{
+public:
+    // Default is one thread per core.
+    explicit AssetLoader(unsigned numThreads = 0);
+
+    // Finishes any work already requested before returning.
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader & operator=(const AssetLoader &) = delete;
+
+    std::future<SdlPixelBuffer> loadImage(const std::string &filename);
+    std::future<SdlSound> loadSound(const std::string &filename);
+
+private:
+    template <typename T>
+    std::future<T> submit(std::function<T ()> job);
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable hasWork_;
+    std::deque<std::function<void ()>> jobs_;
+    bool stopping_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
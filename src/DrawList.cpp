@@ -0,0 +1,169 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "DrawList.h"
+#include <array>
+#include <cassert>
+
+DrawList::DrawList(const SDL_Rect &view)
+    : view_(view),
+    items_(),
+    z_(),
+    order_(),
+    scratch_()
+{
+}
+
+void DrawList::setView(const SDL_Rect &view)
+{
+    view_ = view;
+}
+
+const SDL_Rect & DrawList::view() const
+{
+    return view_;
+}
+
+void DrawList::add(const SdlSurface &img, Sint16 px, Sint16 py, Uint16 z)
+{
+    if (!img) {
+        return;
+    }
+    SDL_Rect src = {0, 0, static_cast<Uint16>(img->w),
+                    static_cast<Uint16>(img->h)};
+    add(img, src, px, py, z);
+}
+
+void DrawList::add(const SdlSurface &img, const Point &pos, Uint16 z)
+{
+    add(img, pos.first, pos.second, z);
+}
+
+void DrawList::add(const SdlSurface &img, const SDL_Rect &src,
+                   Sint16 px, Sint16 py, Uint16 z, bool mirrored)
+{
+    if (!img) {
+        return;
+    }
+
+    if (!visible(px, py, src.w, src.h)) {
+        return;
+    }
+
+    items_.push_back(Item{img, src, px, py, mirrored, nullptr, SDL_Color(), 0});
+    z_.push_back(z);
+}
+
+void DrawList::addFrame(const SdlSurface &img, int frame, int numFrames,
+                        Sint16 px, Sint16 py, Uint16 z, bool mirrored)
+{
+    if (!img) {
+        return;
+    }
+    assert(frame >= 0 && frame < numFrames);
+    Uint16 frameWidth = img->w / numFrames;
+    SDL_Rect src = {static_cast<Sint16>(frame * frameWidth), 0, frameWidth,
+                    static_cast<Uint16>(img->h)};
+    add(img, src, px, py, z, mirrored);
+}
+
+void DrawList::addTint(const SdlSpanMask &mask, Sint16 px, Sint16 py,
+                       const SDL_Color &color, Uint8 alpha, Uint16 z)
+{
+    if (!visible(px, py, mask.w, mask.rows.size())) {
+        return;
+    }
+
+    SDL_Rect none = {0, 0, 0, 0};
+    items_.push_back(Item{nullptr, none, px, py, false, &mask, color, alpha});
+    z_.push_back(z);
+}
+
+int DrawList::size() const
+{
+    return items_.size();
+}
+
+void DrawList::draw()
+{
+    sortByZ();
+
+    SdlSetClipRect(view_, [this]
+    {
+        for (auto i : order_) {
+            const auto &item = items_[i];
+            if (item.mask) {
+                sdlTintSpans(*item.mask, item.px, item.py, item.color,
+                             item.alpha);
+            }
+            else if (item.mirrored) {
+                sdlBlitMirrored(item.img, item.src, item.px, item.py);
+            }
+            else {
+                sdlBlit(item.img, item.src, item.px, item.py);
+            }
+        }
+    });
+
+    clear();
+}
+
+void DrawList::clear()
+{
+    // Keep the capacity, the next frame will need about as much.
+    items_.clear();
+    z_.clear();
+    order_.clear();
+}
+
+// Skip anything that can't be seen.
+bool DrawList::visible(Sint16 px, Sint16 py, Uint16 w, Uint16 h) const
+{
+    return px < view_.x + view_.w && py < view_.y + view_.h &&
+        px + w > view_.x && py + h > view_.y;
+}
+
+// Radix sort on z, a byte at a time.  Each pass is a counting sort, which is
+// stable, so items with equal z stay in the order they were added.  Most
+// frames only use a handful of small z values, so a pass where every item
+// lands in the same bucket is skipped.
+void DrawList::sortByZ()
+{
+    auto n = items_.size();
+    order_.resize(n);
+    for (Uint32 i = 0; i < n; ++i) {
+        order_[i] = i;
+    }
+    scratch_.resize(n);
+
+    for (int shift = 0; shift < 16; shift += 8) {
+        std::array<Uint32, 256> count;
+        count.fill(0);
+        for (auto z : z_) {
+            ++count[(z >> shift) & 0xff];
+        }
+        if (count[(z_.empty() ? 0 : z_[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        Uint32 total = 0;
+        for (auto &c : count) {
+            auto bucketSize = c;
+            c = total;
+            total += bucketSize;
+        }
+        for (auto i : order_) {
+            scratch_[count[(z_[i] >> shift) & 0xff]++] = i;
+        }
+        order_.swap(scratch_);
+    }
+}
@@ -0,0 +1,81 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include "sdl_helper.h"
+#include <vector>
+
+// Collect everything to be drawn in a frame, then draw it all at once in
+// z-order (lowest first).  Items with the same z are drawn in the order they
+// were added, so callers don't have to order their own draw calls.  Anything
+// entirely outside the view is dropped when it's added, and the rest is
+// clipped to the view as it's drawn.
+//
+// Typical usage:
+//     list.add(background, 0, 0, 0);
+//     for (...each unit...) list.addFrame(unit.img, ..., 1);
+//     list.draw();
+class DrawList
+{
+public:
+    explicit DrawList(const SDL_Rect &view);
+
+    // Screen area to draw into.
+    void setView(const SDL_Rect &view);
+    const SDL_Rect & view() const;
+
+    // Draw the whole image, a region of it, or one frame of a sprite sheet
+    // with (px,py) as the upper-left corner.
+    void add(const SdlSurface &img, Sint16 px, Sint16 py, Uint16 z);
+    void add(const SdlSurface &img, const Point &pos, Uint16 z);
+    void add(const SdlSurface &img, const SDL_Rect &src, Sint16 px, Sint16 py,
+             Uint16 z, bool mirrored = false);
+    void addFrame(const SdlSurface &img, int frame, int numFrames,
+                  Sint16 px, Sint16 py, Uint16 z, bool mirrored = false);
+
+    // Blend a color into the pixels covered by a mask (see sdlTintSpans).
+    // The mask must outlive the next call to draw().
+    void addTint(const SdlSpanMask &mask, Sint16 px, Sint16 py,
+                 const SDL_Color &color, Uint8 alpha, Uint16 z);
+
+    int size() const;
+
+    // Draw everything added since the last call and empty the list.
+    void draw();
+    void clear();
+
+private:
+    struct Item
+    {
+        SdlSurface img;  // null for a tint
+        SDL_Rect src;
+        Sint16 px;
+        Sint16 py;
+        bool mirrored;
+        const SdlSpanMask *mask;
+        SDL_Color color;
+        Uint8 alpha;
+    };
+
+    bool visible(Sint16 px, Sint16 py, Uint16 w, Uint16 h) const;
+    void sortByZ();
+
+    SDL_Rect view_;
+    std::vector<Item> items_;
+    std::vector<Uint16> z_;
+    std::vector<Uint32> order_;  // item indexes, sorted by z
+    std::vector<Uint32> scratch_;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "FileScanner.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#define BOOST_FILESYSTEM_NO_DEPRECATED
+#define BOOST_SYSTEM_NO_DEPRECATED
+#include "boost/filesystem.hpp"
+
+namespace bfs = boost::filesystem;
+
+namespace
+{
+    std::string toLower(std::string str)
+    {
+        std::transform(std::begin(str), std::end(str), std::begin(str),
+                       [] (char c) {
+                           return std::tolower(
+                               static_cast<unsigned char>(c));
+                       });
+        return str;
+    }
+}
+
+FileScanner::FileScanner(std::string dir, std::vector<std::string> extensions,
+                         std::string indexFile)
+    : dir_(std::move(dir)),
+    extensions_(std::move(extensions)),
+    indexFile_(std::move(indexFile)),
+    mutex_(),
+    found_(),
+    stop_(false),
+    done_(false),
+    thread_()
+{
+    for (auto &ext : extensions_) {
+        ext = toLower(ext);
+    }
+    thread_ = std::thread([this] { run(); });
+}
+
+FileScanner::~FileScanner()
+{
+    stop_ = true;
+    thread_.join();
+}
+
+std::vector<std::string> FileScanner::poll()
+{
+    std::vector<std::string> files;
+    std::lock_guard<std::mutex> lock(mutex_);
+    files.swap(found_);
+    return files;
+}
+
+bool FileScanner::done() const
+{
+    return done_;
+}
+
+void FileScanner::run()
+{
+    auto oldIndex = loadIndex();
+    Index newIndex;
+
+    std::vector<std::string> todo = {bfs::path(dir_).make_preferred().string()};
+    while (!todo.empty() && !stop_) {
+        auto dir = todo.back();
+        todo.pop_back();
+
+        boost::system::error_code ec;
+        auto mtime = bfs::last_write_time(dir, ec);
+        if (ec) {
+            std::cerr << "Warning: can't scan " << dir << ": " << ec.message()
+                << '\n';
+            continue;
+        }
+
+        // Adding or removing a file changes the directory's modification
+        // time, so an unchanged directory has the same contents as before.
+        auto iter = oldIndex.find(dir);
+        DirInfo info;
+        if (iter != std::end(oldIndex) && iter->second.mtime == mtime) {
+            info = std::move(iter->second);
+        }
+        else {
+            info = listDir(dir, mtime);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            found_.insert(std::end(found_), std::begin(info.files),
+                          std::end(info.files));
+        }
+        todo.insert(std::end(todo), info.subdirs.rbegin(), info.subdirs.rend());
+        newIndex.emplace(dir, std::move(info));
+    }
+
+    if (!stop_) {
+        saveIndex(newIndex);
+    }
+    done_ = true;
+}
+
+bool FileScanner::wanted(const std::string &filename) const
+{
+    auto ext = toLower(bfs::path(filename).extension().string());
+    return std::find(std::begin(extensions_), std::end(extensions_), ext) !=
+        std::end(extensions_);
+}
+
+FileScanner::DirInfo FileScanner::listDir(const std::string &dir,
+                                          std::time_t mtime) const
+{
+    DirInfo info;
+    info.mtime = mtime;
+
+    boost::system::error_code ec;
+    bfs::directory_iterator i(dir, ec);
+    for (; !ec && i != bfs::directory_iterator(); i.increment(ec)) {
+        if (stop_) break;
+
+        // Don't follow links to directories, they could form a loop.
+        auto path = bfs::path(i->path()).make_preferred().string();
+        auto status = i->symlink_status(ec);
+        if (ec) break;
+        if (is_directory(status)) {
+            info.subdirs.push_back(path);
+            continue;
+        }
+        if (wanted(path)) {
+            info.files.push_back(path);
+        }
+    }
+    if (ec) {
+        std::cerr << "Warning: error scanning " << dir << ": " << ec.message()
+            << '\n';
+    }
+
+    std::sort(std::begin(info.files), std::end(info.files));
+    std::sort(std::begin(info.subdirs), std::end(info.subdirs));
+    return info;
+}
+
+// The index is plain text, one entry per line.  Each directory is followed by
+// the files and subdirectories it contains:
+//     D <mtime> <path>
+//     F <path>
+//     S <path>
+FileScanner::Index FileScanner::loadIndex() const
+{
+    Index index;
+    if (indexFile_.empty()) {
+        return index;
+    }
+
+    std::ifstream in(indexFile_);
+    DirInfo *current = nullptr;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream str(line);
+        char type = 0;
+        str >> type;
+        if (type == 'D') {
+            DirInfo d;
+            std::string path;
+            str >> d.mtime;
+            str.ignore(1);
+            std::getline(str, path);
+            current = &index.emplace(path, std::move(d)).first->second;
+        }
+        else if (type == 'F' && current) {
+            std::string path;
+            str.ignore(1);
+            std::getline(str, path);
+            current->files.push_back(path);
+        }
+        else if (type == 'S' && current) {
+            std::string path;
+            str.ignore(1);
+            std::getline(str, path);
+            current->subdirs.push_back(path);
+        }
+        if (!str) {
+            std::cerr << "Warning: ignoring bad index file " << indexFile_
+                << '\n';
+            return {};
+        }
+    }
+
+    return index;
+}
+
+void FileScanner::saveIndex(const Index &index) const
+{
+    if (indexFile_.empty()) {
+        return;
+    }
+
+    std::ofstream out(indexFile_);
+    for (const auto &d : index) {
+        out << "D " << d.second.mtime << ' ' << d.first << '\n';
+        for (const auto &f : d.second.files) {
+            out << "F " << f << '\n';
+        }
+        for (const auto &s : d.second.subdirs) {
+            out << "S " << s << '\n';
+        }
+    }
+    if (!out) {
+        std::cerr << "Warning: couldn't save index file " << indexFile_ << '\n';
+    }
+}
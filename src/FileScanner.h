@@ -0,0 +1,80 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef FILE_SCANNER_H
+#define FILE_SCANNER_H
+
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Search a directory tree for files with the given extensions on a background
+// thread.  Results arrive a directory at a time through poll(), so the caller
+// can show them as they're found.
+//
+// What was found is saved to an index file (each directory with its
+// modification time and the files it holds).  On the next scan, any directory whose modification time hasn't changed is taken
+// from the index instead of being listed again, so a scan of an unchanged
+// tree only costs one stat per directory.
+class FileScanner
+{
+public:
+    // Extensions include the dot and are matched without regard to case.
+    // Pass an empty index filename to always do a full scan.
+    FileScanner(std::string dir, std::vector<std::string> extensions,
+                std::string indexFile);
+
+    // Stops the scan if it's still running.  The index is only saved when
+    // the scan finishes.
+    ~FileScanner();
+
+    FileScanner(const FileScanner &) = delete;
+    FileScanner & operator=(const FileScanner &) = delete;
+
+    // Return the files found since the last call.
+    std::vector<std::string> poll();
+
+    // True once every directory has been scanned.  There could still be
+    // results waiting for poll().
+    bool done() const;
+
+private:
+    struct DirInfo
+    {
+        std::time_t mtime;
+        std::vector<std::string> files;
+        std::vector<std::string> subdirs;
+    };
+    using Index = std::map<std::string, DirInfo>;
+
+    void run();
+    bool wanted(const std::string &filename) const;
+    DirInfo listDir(const std::string &dir, std::time_t mtime) const;
+    Index loadIndex() const;
+    void saveIndex(const Index &index) const;
+
+    std::string dir_;
+    std::vector<std::string> extensions_;
+    std::string indexFile_;
+
+    std::mutex mutex_;
+    std::vector<std::string> found_;  // not yet returned by poll()
+    std::atomic<bool> stop_;
+    std::atomic<bool> done_;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#define BOOST_TEST_MODULE FileScanner_Test
+#include <boost/test/unit_test.hpp>
+
+#include "FileScanner.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#define BOOST_FILESYSTEM_NO_DEPRECATED
+#define BOOST_SYSTEM_NO_DEPRECATED
+#include "boost/filesystem.hpp"
+
+namespace bfs = boost::filesystem;
+
+namespace
+{
+    // A small music library in a temporary directory, removed at the end of
+    // each test.
+    struct Library
+    {
+        Library()
+            : root(bfs::temp_directory_path() / bfs::unique_path()),
+            index((root / "music.index").string())
+        {
+            bfs::create_directories(root / "sub");
+            for (auto name : {"a.ogg", "b.OGG", "c.txt", "sub/d.ogg"}) {
+                std::ofstream((root / name).string()) << name;
+            }
+        }
+
+        ~Library()
+        {
+            boost::system::error_code ec;
+            bfs::remove_all(root, ec);
+        }
+
+        std::string path(const char *name) const
+        {
+            return (root / name).make_preferred().string();
+        }
+
+        // Run a scan to completion and return everything it found, sorted.
+        std::vector<std::string> scan() const
+        {
+            FileScanner scanner(root.string(), {".ogg"}, index);
+            while (!scanner.done()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            auto files = scanner.poll();
+            std::sort(std::begin(files), std::end(files));
+            return files;
+        }
+
+        bfs::path root;
+        std::string index;
+    };
+}
+
+// A second scan reads back exactly what the first one saved.
+BOOST_AUTO_TEST_CASE(IndexRoundTrip)
+{
+    Library lib;
+    std::vector<std::string> expected =
+        {lib.path("a.ogg"), lib.path("b.OGG"), lib.path("sub/d.ogg")};
+
+    auto first = lib.scan();
+    BOOST_CHECK(first == expected);
+    BOOST_REQUIRE(bfs::exists(lib.index));
+
+    auto second = lib.scan();
+    BOOST_CHECK(second == expected);
+}
+
+// An unchanged directory comes from the index without being listed again.
+// Plant a file in the index that doesn't exist on disk: it only shows up if
+// the index was used.  Once the directory's modification time changes, the
+// directory is listed again and the planted file goes away.
+BOOST_AUTO_TEST_CASE(ReuseUnchangedDir)
+{
+    Library lib;
+    lib.scan();
+
+    auto rootDir = lib.root.string();
+    std::ostringstream edited;
+    {
+        std::ifstream in(lib.index);
+        std::string line;
+        while (std::getline(in, line)) {
+            edited << line << '\n';
+            if (line.size() > rootDir.size() &&
+                line.compare(0, 2, "D ") == 0 &&
+                line.compare(line.size() - rootDir.size(), rootDir.size(),
+                             rootDir) == 0)
+            {
+                edited << "F " << lib.path("ghost.ogg") << '\n';
+            }
+        }
+    }
+    std::ofstream(lib.index) << edited.str();
+
+    auto reused = lib.scan();
+    BOOST_CHECK(std::find(std::begin(reused), std::end(reused),
+                          lib.path("ghost.ogg")) != std::end(reused));
+
+    bfs::last_write_time(lib.root, bfs::last_write_time(lib.root) - 10);
+    auto rescanned = lib.scan();
+    BOOST_CHECK(std::find(std::begin(rescanned), std::end(rescanned),
+                          lib.path("ghost.ogg")) == std::end(rescanned));
+    BOOST_CHECK_EQUAL(rescanned.size(), 3u);
+}
@@ -13,11 +13,24 @@
 #include "Minimap.h"
 
 #include "RandomMap.h"
+#include "algo.h"
 #include "terrain.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <tuple>
 
+namespace
+{
+    // Same order as the Terrain enum.
+    const SDL_Color terrainColors[] = {{16, 96, 16, 0},  // grass
+                                       {112, 112, 64, 0},  // dirt
+                                       {208, 192, 128, 0},  // sand
+                                       {0, 64, 144, 0},  // water
+                                       {48, 48, 48, 0},  // swamp
+                                       {240, 240, 240, 0}};  // snow
+}
+
 Minimap::Minimap(const RandomMap &map, const SDL_Rect &displayArea)
     : map_(map),
     displayArea_(displayArea),
@@ -25,19 +38,33 @@ Minimap::Minimap(const RandomMap &map, const SDL_Rect &displayArea)
     height_(displayArea_.h),
     hScale_(map_.pWidth() / static_cast<double>(width_)),
     vScale_(map_.pHeight() / static_cast<double>(height_)),
-    surface_()
+    surface_(),
+    pixels_()
 {
+    // The future's destructor waits for the thread to finish.  Since it's the
+    // last member, it's destroyed before anything the thread might use.
+    pixels_ = std::async(std::launch::async, [this] { return generate(); });
 }
 
 void Minimap::draw()
 {
-    if (!surface_) {
-        generate();
+    if (!surface_ && isReady()) {
+        surface_ = sdlDisplayFormat(pixels_.get());
     }
+
     if (surface_) {
         sdlClear(displayArea_);
         sdlBlit(surface_, displayArea_.x, displayArea_.y);
     }
+    else {
+        auto gray = SDL_MapRGB(screen->format, 64, 64, 64);
+        SDL_FillRect(screen, &displayArea_, gray);
+    }
+}
+
+bool Minimap::isReady() const
+{
+    return surface_ || ::isReady(pixels_);
 }
 
 SDL_Rect Minimap::drawBoundingBox()
@@ -68,49 +95,121 @@ SDL_Rect Minimap::drawBoundingBox()
     return {box_nw_x, box_nw_y, box_width, box_height};
 }
 
-void Minimap::generate()
+void Minimap::update(const std::vector<Point> &hexes)
 {
-    auto surf = sdlCreateSurface(width_, height_);
-    Uint32 terrainColors[] = {SDL_MapRGB(surf->format, 16, 96, 16),  // grass
-                              SDL_MapRGB(surf->format, 112, 112, 64),  // dirt
-                              SDL_MapRGB(surf->format, 208, 192, 128),  // sand
-                              SDL_MapRGB(surf->format, 0, 64, 144),  // water
-                              SDL_MapRGB(surf->format, 48, 48, 48),  // swamp
-                              SDL_MapRGB(surf->format, 240, 240, 240)};  // snow
-
-    // For each pixel of minimap,
-    //     Get corresponding set of pixels on the main map
-    //     Find most common terrain type in that set
-    //     Draw that color for the pixel
-    //
-    // note: this will have to be fixed if BitsPerPixel is ever not 32.
-    SdlLock(surf, [&] {
-        for (Sint16 x = 0; x < width_; ++x) {
-            for (Sint16 y = 0; y < height_; ++y) {
-                int mostCommon = GRASS;
-                int count = 0;
-                for (Sint16 i = 0; i < hScale_; ++i) {
-                    for (Sint16 j = 0; j < vScale_; ++j) {
-                        int terrain = map_.getTerrainAt(x * hScale_ + i,
-                                                        y * vScale_ + j);
-                        if (terrain == mostCommon) {
-                            ++count;
-                        }
-                        else if (count == 0) {
-                            mostCommon = terrain;
-                            count = 1;
-                        }
-                        else {
-                            --count;
-                        }
-                    }
-                }
-                assert(mostCommon >= 0 && mostCommon < NUM_TERRAINS);
-                auto pixel = static_cast<Uint32 *>(surf->pixels) + y*width_ + x;
-                *pixel = terrainColors[mostCommon];
+    assert(isReady());
+    if (!surface_) {
+        surface_ = sdlDisplayFormat(pixels_.get());
+    }
+    if (!surface_) {
+        return;
+    }
+
+    Uint32 colors[NUM_TERRAINS];
+    for (int t = 0; t < NUM_TERRAINS; ++t) {
+        const auto &c = terrainColors[t];
+        colors[t] = sdlPixelRGB(c.r, c.g, c.b);
+    }
+
+    // The minimap surface is in the screen format, which might not be 32 bits
+    // per pixel.  Draw each changed area into a pixel buffer and let SDL
+    // convert it, the same as generate().
+    for (const auto &hex : hexes) {
+        // Hexes on the map edge are mirrored into the border around the map,
+        // so cover the neighboring hexes too.
+        auto mp = map_.mPixelFromHex(hex);
+        Sint16 left = mp.first - pHexSize * 3 / 4;
+        Sint16 top = mp.second - pHexSize;
+        Sint16 right = mp.first + pHexSize * 7 / 4;
+        Sint16 bottom = mp.second + pHexSize * 2;
+
+        Sint16 xMin = std::max<Sint16>(0, left / hScale_);
+        Sint16 yMin = std::max<Sint16>(0, top / vScale_);
+        Sint16 xMax = std::min<Sint16>(width_ - 1, right / hScale_);
+        Sint16 yMax = std::min<Sint16>(height_ - 1, bottom / vScale_);
+        if (xMin > xMax || yMin > yMax) {
+            continue;
+        }
+
+        SdlPixelBuffer buf(xMax - xMin + 1, yMax - yMin + 1);
+        for (Sint16 y = yMin; y <= yMax; ++y) {
+            auto row = &buf.pixels[(y - yMin) * buf.w];
+            for (Sint16 x = xMin; x <= xMax; ++x) {
+                row[x - xMin] = colors[terrainAt(x, y)];
             }
         }
-    });
 
-    surface_ = sdlDisplayFormat(surf);
+        auto patch = sdlDisplayFormat(buf);
+        if (!patch) {
+            continue;
+        }
+        SDL_Rect dest = {xMin, yMin, 0, 0};
+        if (SDL_BlitSurface(patch.get(), nullptr, surface_.get(), &dest) < 0) {
+            std::cerr << "Error updating minimap: " << SDL_GetError() << '\n';
+        }
+    }
+}
+
+SdlPixelBuffer Minimap::generate() const
+{
+    SdlPixelBuffer buf(width_, height_);
+    Uint32 colors[NUM_TERRAINS];
+    for (int t = 0; t < NUM_TERRAINS; ++t) {
+        const auto &c = terrainColors[t];
+        colors[t] = sdlPixelRGB(c.r, c.g, c.b);
+    }
+
+    for (Sint16 y = 0; y < height_; ++y) {
+        auto row = &buf.pixels[y * width_];
+        for (Sint16 x = 0; x < width_; ++x) {
+            row[x] = colors[terrainAt(x, y)];
+        }
+    }
+
+    return buf;
+}
+
+int Minimap::terrainAt(Sint16 x, Sint16 y) const
+{
+    // Find the rectangle on the main map corresponding to this pixel.  Use
+    // the most common terrain among the hexes under a grid of samples across
+    // it, corners included.
+    //
+    // Samples are at most half a hex apart, so no hex inside the rectangle is
+    // missed.  While a minimap pixel is smaller than a hex, that's just the
+    // four corners.  On large maps a pixel covers many hexes and the grid
+    // grows with it, so the cost scales with the ratio of map size to minimap
+    // size.
+    Sint16 left = x * hScale_;
+    Sint16 right = std::min<Sint16>((x + 1) * hScale_ - 1, map_.pWidth() - 1);
+    Sint16 top = y * vScale_;
+    Sint16 bottom = std::min<Sint16>((y + 1) * vScale_ - 1,
+                                     map_.pHeight() - 1);
+    Sint16 center = (left + right) / 2;
+    Sint16 middle = (top + bottom) / 2;
+
+    const int spacing = pHexSize / 2;
+    int cols = std::max(2, (right - left + spacing - 1) / spacing + 1);
+    int rows = std::max(2, (bottom - top + spacing - 1) / spacing + 1);
+
+    // The center sample wins any ties.
+    int mostCommon = map_.getTerrainAt(center, middle);
+    assert(mostCommon >= 0 && mostCommon < NUM_TERRAINS);
+    int counts[NUM_TERRAINS] = {0};
+    ++counts[mostCommon];
+    for (int i = 0; i < rows; ++i) {
+        Sint16 py = top + (bottom - top) * i / (rows - 1);
+        for (int j = 0; j < cols; ++j) {
+            Sint16 px = left + (right - left) * j / (cols - 1);
+            auto terrain = map_.getTerrainAt(px, py);
+            assert(terrain >= 0 && terrain < NUM_TERRAINS);
+            ++counts[terrain];
+        }
+    }
+    for (int t = 0; t < NUM_TERRAINS; ++t) {
+        if (counts[t] > counts[mostCommon]) {
+            mostCommon = t;
+        }
+    }
+    return mostCommon;
 }
@@ -14,21 +14,35 @@
 #define MINIMAP_H
 
 #include "sdl_helper.h"
+#include <future>
+#include <vector>
 class RandomMap;
 
 class Minimap
 {
 public:
+    // Starts building the minimap image on a background thread.  The map must
+    // not change until isReady() returns true.
     Minimap(const RandomMap &map, const SDL_Rect &displayArea);
 
+    // Draw a placeholder until the background thread finishes.
     void draw();
+    bool isReady() const;
+
+    // Redo only the part of the minimap covering the given hexes.  Use this
+    // with RandomMap::onChange() after the minimap is ready.
+    void update(const std::vector<Point> &hexes);
 
     // Draw a dotted rectangle representing the current visible map area.
     // Return the screen coordinates of that rectangle.
     SDL_Rect drawBoundingBox();
 
 private:
-    void generate();
+    // Safe to call from any thread.
+    SdlPixelBuffer generate() const;
+
+    // Return the terrain to draw at the given minimap pixel.
+    int terrainAt(Sint16 x, Sint16 y) const;
 
     const RandomMap &map_;
     SDL_Rect displayArea_;
@@ -37,6 +51,7 @@ private:
     double hScale_;
     double vScale_;
     SdlSurface surface_;
+    std::future<SdlPixelBuffer> pixels_;  // keep last, see constructor
 };
 
 #endif
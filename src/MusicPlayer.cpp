@@ -0,0 +1,600 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "MusicPlayer.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iterator>
+
+// The header's static callback structs are unused here and would trip
+// -Werror.
+#define OV_EXCLUDE_STATIC_CALLBACKS
+#include "vorbis/vorbisfile.h"
+
+namespace
+{
+    // Match the volume sdlPlayMusic() uses.
+    const int volume = MIX_MAX_VOLUME / 2;
+
+    // How far ahead of playback each track is decoded.
+    const Uint32 bufferSeconds = 2;
+
+    // Decode this much at a time so no one track hogs the worker.
+    const int blockFrames = 4096;
+
+    // Largest number of samples mixed in one pass.
+    const int mixChunk = 1024;
+
+    // RAII wrapper for SDL_LockAudio().  Keeps the audio callback from
+    // running while it's alive.
+    struct AudioLock
+    {
+        AudioLock() { SDL_LockAudio(); }
+        ~AudioLock() { SDL_UnlockAudio(); }
+    };
+}
+
+// One track on its way to the speakers.  The worker thread opens the file and
+// decodes it into a ring buffer, and the audio thread reads from the other
+// end.  Each side only advances its own count of samples written or read.
+// The counts wrap around at 2^32, which is fine since the ring size is a
+// power of 2, and their difference is the number of samples waiting.
+class MusicPlayer::Track
+{
+public:
+    Track(std::string path, int freq, int channels);
+    ~Track();
+
+    Track(const Track &) = delete;
+    Track & operator=(const Track &) = delete;
+
+    const std::string & path() const;
+
+    // Worker thread.  Decode one block if there's room for it.  Return false
+    // if there was nothing to do.
+    bool decode();
+    bool doneDecoding() const;  // reached the end of the file, or cancelled
+
+    // Main thread.  Stop decoding because the track won't be played.
+    void cancel();
+
+    // Audio thread.  Copy out up to numSamples samples, return how many.
+    int read(Sint16 *out, int numSamples);
+    bool finished() const;  // decoded and played all the way through
+
+    Uint32 position() const;  // samples played
+    Uint32 length() const;  // total samples, or 0 if not known yet
+
+private:
+    bool open();
+    bool decodeOgg();
+    bool decodeWhole();
+    Uint32 space() const;
+    void write(const Sint16 *samples, Uint32 numSamples);
+    void close();
+
+    std::string path_;
+    int freq_;
+    int channels_;
+
+    std::vector<Sint16> ring_;
+    std::atomic<Uint32> written_;
+    std::atomic<Uint32> read_;
+    std::atomic<Uint32> length_;
+    std::atomic<bool> eof_;
+    std::atomic<bool> cancelled_;
+
+    // Only the worker thread touches these.
+    bool opened_;
+    Uint32 blockSamples_;  // most a block can decode to
+    bool isOgg_;
+    OggVorbis_File ogg_;
+    int oggBlockBytes_;
+    SDL_AudioCVT cvt_;
+    std::vector<Uint8> cvtBuf_;
+    SdlSound whole_;  // formats other than Ogg Vorbis
+    Uint32 wholePos_;  // samples
+};
+
+MusicPlayer::Track::Track(std::string path, int freq, int channels)
+    : path_(std::move(path)),
+    freq_(freq),
+    channels_(channels),
+    ring_(),
+    written_(0),
+    read_(0),
+    length_(0),
+    eof_(false),
+    cancelled_(false),
+    opened_(false),
+    blockSamples_(0),
+    isOgg_(false),
+    ogg_(),
+    oggBlockBytes_(0),
+    cvt_(),
+    cvtBuf_(),
+    whole_(),
+    wholePos_(0)
+{
+    Uint32 size = 1;
+    while (size < bufferSeconds * freq_ * channels_) {
+        size *= 2;
+    }
+    ring_.resize(size);
+}
+
+MusicPlayer::Track::~Track()
+{
+    close();
+}
+
+const std::string & MusicPlayer::Track::path() const
+{
+    return path_;
+}
+
+bool MusicPlayer::Track::decode()
+{
+    if (doneDecoding()) {
+        return false;
+    }
+    if (!opened_) {
+        opened_ = true;
+        if (!open()) {
+            close();
+            eof_.store(true, std::memory_order_release);
+        }
+        return true;
+    }
+    if (space() < blockSamples_) {
+        return false;
+    }
+
+    bool atEnd = isOgg_ ? decodeOgg() : decodeWhole();
+    if (atEnd) {
+        close();
+        eof_.store(true, std::memory_order_release);
+    }
+    return true;
+}
+
+bool MusicPlayer::Track::doneDecoding() const
+{
+    return eof_.load(std::memory_order_acquire) ||
+        cancelled_.load(std::memory_order_relaxed);
+}
+
+void MusicPlayer::Track::cancel()
+{
+    cancelled_.store(true, std::memory_order_relaxed);
+}
+
+int MusicPlayer::Track::read(Sint16 *out, int numSamples)
+{
+    auto r = read_.load(std::memory_order_relaxed);
+    auto available = written_.load(std::memory_order_acquire) - r;
+    auto n = std::min<Uint32>(numSamples, available);
+
+    const Uint32 mask = ring_.size() - 1;
+    auto start = r & mask;
+    auto first = std::min<Uint32>(n, ring_.size() - start);
+    std::copy(&ring_[start], &ring_[start] + first, out);
+    std::copy(&ring_[0], &ring_[0] + (n - first), out + first);
+
+    read_.store(r + n, std::memory_order_release);
+    return n;
+}
+
+bool MusicPlayer::Track::finished() const
+{
+    // Check eof first so that all of the samples are visible.
+    return eof_.load(std::memory_order_acquire) &&
+        read_.load(std::memory_order_relaxed) ==
+            written_.load(std::memory_order_acquire);
+}
+
+Uint32 MusicPlayer::Track::position() const
+{
+    return read_.load(std::memory_order_relaxed);
+}
+
+Uint32 MusicPlayer::Track::length() const
+{
+    return length_.load(std::memory_order_relaxed);
+}
+
+bool MusicPlayer::Track::open()
+{
+    if (ov_fopen(path_.c_str(), &ogg_) == 0) {
+        isOgg_ = true;
+        auto info = ov_info(&ogg_, -1);
+        if (SDL_BuildAudioCVT(&cvt_, AUDIO_S16SYS, info->channels, info->rate,
+                              AUDIO_S16SYS, channels_, freq_) < 0) {
+            std::cerr << "Error converting " << path_
+                << " to the mixer's format: " << SDL_GetError() << '\n';
+            return false;
+        }
+        oggBlockBytes_ = blockFrames * info->channels * 2;
+        cvtBuf_.resize(oggBlockBytes_ * cvt_.len_mult);
+        blockSamples_ = channels_ +
+            static_cast<Uint32>(oggBlockBytes_ * cvt_.len_ratio / 2);
+
+        auto frames = ov_pcm_total(&ogg_, -1);
+        if (frames > 0) {
+            length_ = static_cast<Uint32>(Uint64(frames) * freq_ / info->rate *
+                                          channels_);
+        }
+    }
+    else {
+        // Mix_LoadWAV() converts the samples to the mixer's format.
+        whole_ = sdlLoadSound(path_.c_str());
+        if (!whole_) {
+            return false;
+        }
+        blockSamples_ = blockFrames * channels_;
+        length_ = whole_->alen / 2;
+    }
+
+    assert(blockSamples_ <= ring_.size());
+    return true;
+}
+
+// Return true at the end of the file.
+bool MusicPlayer::Track::decodeOgg()
+{
+    // ov_read() returns at most one packet at a time.
+    auto buf = reinterpret_cast<char *>(&cvtBuf_[0]);
+    int len = 0;
+    bool atEnd = false;
+    while (len < oggBlockBytes_) {
+        int bitstream = 0;
+        auto bytes = ov_read(&ogg_, buf + len, oggBlockBytes_ - len,
+                             SDL_BYTEORDER == SDL_BIG_ENDIAN, 2, 1, &bitstream);
+        if (bytes == OV_HOLE) {
+            continue;  // skip over corrupt data
+        }
+        if (bytes <= 0) {
+            if (bytes < 0) {
+                std::cerr << "Error decoding " << path_ << '\n';
+            }
+            atEnd = true;
+            break;
+        }
+        len += bytes;
+    }
+
+    if (cvt_.needed && len > 0) {
+        cvt_.buf = &cvtBuf_[0];
+        cvt_.len = len;
+        SDL_ConvertAudio(&cvt_);
+        len = cvt_.len_cvt;
+    }
+    write(reinterpret_cast<const Sint16 *>(&cvtBuf_[0]), len / 2);
+    return atEnd;
+}
+
+// Return true at the end of the file.
+bool MusicPlayer::Track::decodeWhole()
+{
+    auto samples = reinterpret_cast<const Sint16 *>(whole_->abuf);
+    auto total = whole_->alen / 2;
+    auto n = std::min(blockSamples_, total - wholePos_);
+    write(samples + wholePos_, n);
+    wholePos_ += n;
+    return wholePos_ >= total;
+}
+
+Uint32 MusicPlayer::Track::space() const
+{
+    return ring_.size() - (written_.load(std::memory_order_relaxed) -
+                           read_.load(std::memory_order_acquire));
+}
+
+void MusicPlayer::Track::write(const Sint16 *samples, Uint32 numSamples)
+{
+    auto w = written_.load(std::memory_order_relaxed);
+    const Uint32 mask = ring_.size() - 1;
+    auto start = w & mask;
+    auto first = std::min<Uint32>(numSamples, ring_.size() - start);
+    std::copy(samples, samples + first, &ring_[start]);
+    std::copy(samples + first, samples + numSamples, &ring_[0]);
+
+    written_.store(w + numSamples, std::memory_order_release);
+}
+
+void MusicPlayer::Track::close()
+{
+    if (isOgg_) {
+        ov_clear(&ogg_);
+        isOgg_ = false;
+    }
+    whole_.reset();
+}
+
+MusicPlayer::MusicPlayer(Uint32 crossfade_ms)
+    : freq_(0),
+    channels_(0),
+    fadeSamples_(0),
+    tracks_(),
+    mutex_(),
+    hasWork_(),
+    newTracks_(),
+    stop_(false),
+    worker_(),
+    playing_(nullptr),
+    upcoming_(nullptr),
+    trackChanges_(0),
+    paused_(false)
+{
+    Uint16 format = 0;
+    if (Mix_QuerySpec(&freq_, &format, &channels_) == 0) {
+        std::cerr << "Error querying audio format: " << Mix_GetError() << '\n';
+    }
+    assert(format == AUDIO_S16SYS);
+    fadeSamples_ = Uint64(crossfade_ms) * freq_ / 1000 * channels_;
+
+    worker_ = std::thread([this] { decodeLoop(); });
+
+    Mix_HaltMusic();
+    Mix_HookMusic(mixHook, this);
+}
+
+MusicPlayer::~MusicPlayer()
+{
+    // Once this returns, the audio thread is done with our tracks.
+    Mix_HookMusic(nullptr, nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    hasWork_.notify_one();
+    worker_.join();
+}
+
+void MusicPlayer::play(const std::string &path)
+{
+    Track *track = nullptr;
+    {
+        AudioLock lock;
+        if (upcoming_ && upcoming_->path() == path) {
+            track = upcoming_;
+        }
+    }
+    if (!track) {
+        track = startTrack(path);
+    }
+
+    {
+        AudioLock lock;
+        playing_ = track;
+        upcoming_ = nullptr;
+        trackChanges_ = 0;
+    }
+    releaseUnused();
+}
+
+void MusicPlayer::queue(const std::string &path)
+{
+    {
+        AudioLock lock;
+        if (upcoming_ && upcoming_->path() == path) {
+            return;
+        }
+    }
+
+    auto track = startTrack(path);
+    {
+        AudioLock lock;
+        upcoming_ = track;
+    }
+    releaseUnused();
+}
+
+void MusicPlayer::pause()
+{
+    AudioLock lock;
+    paused_ = true;
+}
+
+void MusicPlayer::resume()
+{
+    AudioLock lock;
+    paused_ = false;
+}
+
+bool MusicPlayer::isPaused() const
+{
+    AudioLock lock;
+    return paused_;
+}
+
+bool MusicPlayer::isPlaying() const
+{
+    AudioLock lock;
+    return playing_ != nullptr || upcoming_ != nullptr;
+}
+
+Uint32 MusicPlayer::position_ms() const
+{
+    AudioLock lock;
+    return playing_ ? toMs(playing_->position()) : 0;
+}
+
+Uint32 MusicPlayer::length_ms() const
+{
+    AudioLock lock;
+    return playing_ ? toMs(playing_->length()) : 0;
+}
+
+bool MusicPlayer::update()
+{
+    int changes = 0;
+    {
+        AudioLock lock;
+        changes = trackChanges_;
+        trackChanges_ = 0;
+    }
+    releaseUnused();
+    return changes > 0;
+}
+
+MusicPlayer::Track * MusicPlayer::startTrack(const std::string &path)
+{
+    auto track = std::make_shared<Track>(path, freq_, channels_);
+    tracks_.push_back(track);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        newTracks_.push_back(track);
+    }
+    hasWork_.notify_one();
+    return track.get();
+}
+
+// Let go of the tracks the audio thread is done with.  It only ever moves the
+// upcoming track to playing, so a track it isn't pointing to now will never
+// be played again.  The worker thread may still hold a reference, in which
+// case the track is freed there once it notices the cancel.
+void MusicPlayer::releaseUnused()
+{
+    Track *playing = nullptr;
+    Track *upcoming = nullptr;
+    {
+        AudioLock lock;
+        playing = playing_;
+        upcoming = upcoming_;
+    }
+
+    auto unused = std::partition(std::begin(tracks_), std::end(tracks_),
+        [=] (const TrackPtr &t) {
+            return t.get() == playing || t.get() == upcoming;
+        });
+    std::for_each(unused, std::end(tracks_),
+                  [] (const TrackPtr &t) { t->cancel(); });
+    tracks_.erase(unused, std::end(tracks_));
+}
+
+void MusicPlayer::decodeLoop()
+{
+    // Tracks being decoded, in the order they were started.  The current
+    // track is usually first, so it gets filled first.
+    std::vector<TrackPtr> active;
+    bool busy = false;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!busy && newTracks_.empty() && !stop_) {
+                // Every ring is full.  A ring holds at least a second of
+                // audio, so checking back this often keeps them nearly full.
+                hasWork_.wait_for(lock, std::chrono::milliseconds(20));
+            }
+            if (stop_) {
+                return;
+            }
+            std::move(std::begin(newTracks_), std::end(newTracks_),
+                      std::back_inserter(active));
+            newTracks_.clear();
+        }
+
+        busy = false;
+        for (auto &t : active) {
+            if (t->decode()) {
+                busy = true;
+            }
+        }
+
+        active.erase(std::remove_if(std::begin(active), std::end(active),
+            [] (const TrackPtr &t) { return t->doneDecoding(); }),
+            std::end(active));
+    }
+}
+
+void MusicPlayer::mixHook(void *player, Uint8 *stream, int len)
+{
+    auto self = static_cast<MusicPlayer *>(player);
+    self->mix(reinterpret_cast<Sint16 *>(stream), len / 2);
+}
+
+// Runs on the audio thread with the audio locked.  The stream starts out
+// silent.  Nothing here allocates or frees memory.
+void MusicPlayer::mix(Sint16 *out, int numSamples)
+{
+    if (paused_) {
+        return;
+    }
+
+    // Keep every pass a whole number of frames so the crossfade lines up
+    // left and right channels.
+    const int chunk = mixChunk / channels_ * channels_;
+    Sint16 fadeIn[mixChunk];
+
+    while (numSamples > 0) {
+        // Start the next track as soon as the current one runs out.  The
+        // main thread frees the old one.
+        if (!playing_ || playing_->finished()) {
+            playing_ = upcoming_;
+            upcoming_ = nullptr;
+            if (!playing_) {
+                return;
+            }
+            ++trackChanges_;
+        }
+
+        int n = playing_->read(out, std::min(numSamples, chunk));
+        if (n == 0) {
+            if (playing_->finished()) {
+                continue;
+            }
+            // The worker hasn't caught up yet.  Leave the rest silent and
+            // pick up where we left off next time.
+            return;
+        }
+
+        // Within the crossfade window, ramp the next track up as the current
+        // one ramps down.  Sample i of this pass has 'left + n - 1 - i'
+        // samples after it.
+        auto length = playing_->length();
+        auto pos = playing_->position();
+        if (upcoming_ && fadeSamples_ > 0 && length > 0) {
+            Uint32 left = length > pos ? length - pos : 0;
+            if (left < fadeSamples_) {
+                int numFade = std::min<Uint32>(n, fadeSamples_ - left);
+                int first = n - numFade;
+                int got = upcoming_->read(fadeIn, numFade);
+                for (int i = first; i < n; ++i) {
+                    Sint64 remaining = left + (n - 1 - i);
+                    Sint32 nextSample = i - first < got ? fadeIn[i - first] : 0;
+                    out[i] = (out[i] * remaining +
+                              nextSample * Sint64(fadeSamples_ - remaining)) /
+                        fadeSamples_;
+                }
+            }
+        }
+
+        for (int i = 0; i < n; ++i) {
+            out[i] = out[i] * volume / MIX_MAX_VOLUME;
+        }
+        out += n;
+        numSamples -= n;
+    }
+}
+
+Uint32 MusicPlayer::toMs(Uint32 samples) const
+{
+    if (freq_ == 0 || channels_ == 0) {
+        return 0;
+    }
+    return Uint64(samples) / channels_ * 1000 / freq_;
+}
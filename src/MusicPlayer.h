@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef MUSIC_PLAYER_H
+#define MUSIC_PLAYER_H
+
+#include "sdl_helper.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Play tracks back to back with no gap between them, optionally crossfading.
+// SDL_mixer's own music player has to open and start decoding each file when
+// it's asked to play it, which leaves a gap.  Instead, a worker thread decodes
+// each track a block at a time into a ring buffer, staying a couple of seconds
+// ahead of playback, and we feed the samples to the mixer ourselves through
+// Mix_HookMusic().  The queued track's buffer fills while the current one
+// plays.  Knowing where we are in the samples also gives us the track
+// position, which SDL_mixer can't report.
+//
+// Ogg Vorbis files are streamed with libvorbisfile, so a track never holds
+// more than its ring buffer.  Other formats go through Mix_LoadWAV(), which
+// decodes the whole file at once on the worker thread and keeps it in memory
+// while it plays.  That defeats the point of the ring buffer, so prefer Ogg.
+// Mix_LoadWAV() can't read MP3s at all; SDL_mixer only plays those as music.
+// Only one MusicPlayer can exist at a time, and it replaces any music played
+// with sdlPlayMusic().
+class MusicPlayer
+{
+public:
+    explicit MusicPlayer(Uint32 crossfade_ms = 0);
+    ~MusicPlayer();
+
+    MusicPlayer(const MusicPlayer &) = delete;
+    MusicPlayer & operator=(const MusicPlayer &) = delete;
+
+    // Start playing a track right away.  If it's the queued track, whatever
+    // has been decoded already plays without a wait.  Neither this nor
+    // queue() touches the file; there's silence until the first block is
+    // decoded.
+    void play(const std::string &path);
+
+    // Start decoding the track that should follow the current one.  It
+    // starts as soon as the current one ends, or crossfades in.  If nothing
+    // is playing, it starts right away.
+    void queue(const std::string &path);
+
+    void pause();
+    void resume();
+    bool isPaused() const;
+    bool isPlaying() const;  // true when paused too
+
+    // Position and length of the current track.  The length is 0 until the
+    // file has been opened.
+    Uint32 position_ms() const;
+    Uint32 length_ms() const;
+
+    // Call this once per frame.  Return true if the queued track has taken
+    // over since the last call, meaning it's time to queue another one.
+    bool update();
+
+private:
+    class Track;
+    using TrackPtr = std::shared_ptr<Track>;
+
+    Track * startTrack(const std::string &path);
+    void releaseUnused();
+    void decodeLoop();
+
+    static void mixHook(void *player, Uint8 *stream, int len);
+    void mix(Sint16 *out, int numSamples);
+    Uint32 toMs(Uint32 samples) const;
+
+    // Audio format, always 16-bit samples.
+    int freq_;
+    int channels_;
+    Uint32 fadeSamples_;
+
+    // Every track the audio thread might still read from.  Only the main
+    // thread touches this, so a track is never freed on the audio thread.
+    std::vector<TrackPtr> tracks_;
+
+    // Handing new tracks to the decoding thread.
+    std::mutex mutex_;
+    std::condition_variable hasWork_;
+    std::vector<TrackPtr> newTracks_;
+    bool stop_;
+    std::thread worker_;
+
+    // Shared with the audio thread, only touch while the audio is locked.
+    Track *playing_;
+    Track *upcoming_;
+    int trackChanges_;
+    bool paused_;
+};
+
+#endif
@@ -12,8 +12,10 @@
 */
 #include "Pathfinder.h"
 #include <algorithm>
+#include <cassert>
 #include <memory>
 #include <unordered_map>
+#include <utility>
 
 struct PathNode
 {
@@ -32,13 +34,120 @@ namespace {
         return std::make_shared<PathNode>(PathNode{prev, costSoFar,
                                                    estTotalCost, visited});
     }
+
+    // Both open lists hold (estimated total cost, node) pairs.  Instead of
+    // moving a node when we find a shorter path to it, we push it again.  The
+    // cheaper entry comes out first, and the search skips the stale one
+    // because by then the node has been visited.
+    typedef std::pair<int, int> OpenEntry;
+
+    class HeapQueue
+    {
+    public:
+        HeapQueue() : heap_() {}
+
+        bool empty() const { return heap_.empty(); }
+
+        void push(int cost, int node)
+        {
+            heap_.emplace_back(cost, node);
+            push_heap(std::begin(heap_), std::end(heap_), Cheaper());
+        }
+
+        int pop()
+        {
+            pop_heap(std::begin(heap_), std::end(heap_), Cheaper());
+            auto node = heap_.back().second;
+            heap_.pop_back();
+            return node;
+        }
+
+    private:
+        // The heap functions confusingly use operator< to build a heap with
+        // the *largest* element on top.  We want to get the node with the
+        // *least* cost, so we have to order nodes in the opposite way.
+        struct Cheaper
+        {
+            bool operator()(const OpenEntry &lhs, const OpenEntry &rhs) const
+            {
+                return lhs > rhs;
+            }
+        };
+
+        std::vector<OpenEntry> heap_;
+    };
+
+    // Dial's algorithm.  A* never pops a node cheaper than the last one, and
+    // a step adds at most a few points of cost, so every open node falls
+    // within a small window above the current cost.  Keep one bucket per cost
+    // in that window, reusing them in a ring as the window slides forward.
+    class BucketQueue
+    {
+    public:
+        explicit BucketQueue(int maxStepCost)
+            : buckets_(maxStepCost + 1),
+            cur_(0),
+            size_(0)
+        {
+        }
+
+        bool empty() const { return size_ == 0; }
+
+        void push(int cost, int node)
+        {
+            // An estimate that drops faster than the step costs can make a
+            // node cheaper than the last one popped.  Don't lose the node,
+            // the path just might not be the shortest.
+            cost = std::max(cost, cur_);
+            if (cost - cur_ >= static_cast<int>(buckets_.size())) {
+                grow(cost - cur_ + 1);
+            }
+            buckets_[cost % buckets_.size()].emplace_back(cost, node);
+            ++size_;
+        }
+
+        int pop()
+        {
+            assert(!empty());
+            auto *bucket = &buckets_[cur_ % buckets_.size()];
+            while (bucket->empty()) {
+                ++cur_;
+                bucket = &buckets_[cur_ % buckets_.size()];
+            }
+            auto node = bucket->back().second;
+            bucket->pop_back();
+            --size_;
+            return node;
+        }
+
+    private:
+        // Only happens if the caller's max step cost was too low, or the
+        // estimate jumps by more than that.
+        void grow(int minSize)
+        {
+            auto size = std::max<int>(minSize, 2 * buckets_.size());
+            std::vector<std::vector<OpenEntry>> buckets(size);
+            for (auto &b : buckets_) {
+                for (auto &e : b) {
+                    buckets[e.first % size].push_back(e);
+                }
+            }
+            buckets_.swap(buckets);
+        }
+
+        std::vector<std::vector<OpenEntry>> buckets_;
+        int cur_;  // no open node costs less than this
+        int size_;
+    };
 }
 
 Pathfinder::Pathfinder()
     : neighbors_{[] (int) { return std::vector<int>(); }},
     goal_{[] (int) { return false; }},
     stepCost_{[] (int, int) { return 1; }},
-    estimate_{[] (int) { return 0; }}
+    estimate_{[] (int) { return 0; }},
+    maxStepCost_{0},
+    expanded_{0}
 {
 }
 
@@ -67,41 +176,56 @@ void Pathfinder::setEstimate(std::function<int (int)> func)
     estimate_ = func;
 }
 
+void Pathfinder::setMaxStepCost(int maxCost)
+{
+    maxStepCost_ = std::max(maxCost, 0);
+}
+
 std::vector<int> Pathfinder::getPathFrom(int start) const
 {
+    expanded_ = 0;
     if (goal_(start)) return {start};
 
+    if (maxStepCost_ > 0) {
+        BucketQueue open(maxStepCost_);
+        return search(start, open);
+    }
+
+    HeapQueue open;
+    return search(start, open);
+}
+
+int Pathfinder::nodesExpanded() const
+{
+    return expanded_;
+}
+
+template <typename Queue>
+std::vector<int> Pathfinder::search(int start, Queue &open) const
+{
     // Record shortest path costs for every node we examine.
     std::unordered_map<int, PathNodePtr> nodes;
-    // Maintain a heap of nodes to consider.
-    std::vector<int> open;
     int goalLoc = -1;
     PathNodePtr goalNode;
 
-    // The heap functions confusingly use operator< to build a heap with the
-    // *largest* element on top.  We want to get the node with the *least* cost,
-    // so we have to order nodes in the opposite way.
-    auto orderByCost = [&] (int lhs, int rhs)
-    {
-        return nodes[lhs]->estTotalCost > nodes[rhs]->estTotalCost;
-    };
-
     nodes.emplace(start, make_node(-1, 0, 0));
-    open.push_back(start);
+    open.push(0, start);
 
     // A* algorithm.  Decays to Dijkstra's if estimate function is always 0.
     while (!open.empty()) {
-        auto loc = open.front();
-        pop_heap(std::begin(open), std::end(open), orderByCost);
-        open.pop_back();
+        auto loc = open.pop();
+        auto &curNode = nodes[loc];
+        if (curNode->visited) {
+            continue;
+        }
         if (goal_(loc)) {
             goalLoc = loc;
-            goalNode = nodes[loc];
+            goalNode = curNode;
             break;
         }
 
-        auto &curNode = nodes[loc];
         curNode->visited = true;
+        ++expanded_;
         for (auto n : neighbors_(loc)) {
             auto nIter = nodes.find(n);
             auto step = stepCost_(loc, n);
@@ -118,15 +242,15 @@ std::vector<int> Pathfinder::getPathFrom(int start) const
                     nNode->prev = loc;
                     nNode->costSoFar = curNode->costSoFar + step;
                     nNode->estTotalCost = nNode->costSoFar + estimate_(n);
-                    make_heap(std::begin(open), std::end(open), orderByCost);
+                    open.push(nNode->estTotalCost, n);
                 }
             }
             else {
                 // We haven't seen this node before.  Add it to the open list.
-                nodes.emplace(n, make_node(loc, curNode->costSoFar + step, 
-                    curNode->costSoFar + step + estimate_(n)));
-                open.push_back(n);
-                push_heap(std::begin(open), std::end(open), orderByCost);
+                auto costSoFar = curNode->costSoFar + step;
+                auto estTotalCost = costSoFar + estimate_(n);
+                nodes.emplace(n, make_node(loc, costSoFar, estTotalCost));
+                open.push(estTotalCost, n);
             }
         }
     }
@@ -46,15 +46,33 @@ public:
     // int (int a) -> estimate shortest path from node a to goal.
     void setEstimate(std::function<int (int)> func);
 
+    // (OPTIONAL) Declare the largest cost of a single step.  When step costs
+    // are small integers, this replaces the binary heap of open nodes with a
+    // ring of buckets, one per total cost, which makes every push and pop
+    // O(1).  To be sure of the shortest path, the estimate must not drop by
+    // more than the step cost from one node to the next.  Pass 0 to go back
+    // to the heap.
+    void setMaxStepCost(int maxCost);
+
     // Return the shortest path to the goal from the starting node.  Return an
     // empty list if the goal cannot be found.
     std::vector<int> getPathFrom(int start) const;
 
+    // Number of nodes the most recent search took off the open list and
+    // examined the neighbors of.  Use this to see how much a better estimate
+    // function helps.
+    int nodesExpanded() const;
+
 private:
+    template <typename Queue>
+    std::vector<int> search(int start, Queue &open) const;
+
     std::function<std::vector<int> (int)> neighbors_;
     std::function<bool (int)> goal_;
     std::function<int (int, int)> stepCost_;
     std::function<int (int)> estimate_;
+    int maxStepCost_;
+    mutable int expanded_;
 };
 
 #endif
@@ -12,103 +12,124 @@
 */
 #include "RandomMap.h"
 
+#include "AssetLoader.h"
 #include "Pathfinder.h"
+#include "TextureAtlas.h"
 #include "algo.h"
 #include "terrain.h"
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <deque>
 #include <iterator>
 #include <queue>
 #include <random>
 #include <tuple>
 
-#include <iostream> // XXX
-
 namespace {
-    std::vector<SdlSurface> tiles;
-    std::vector<SdlSurface> edges;
-    std::vector<SdlSurface> grassObstacles;
-    std::vector<SdlSurface> dirtObstacles;
-    std::vector<SdlSurface> sandObstacles;
-    std::vector<SdlSurface> waterObstacles;
-    std::vector<SdlSurface> swampObstacles;
-    std::vector<SdlSurface> snowObstacles;
-    SdlSurface hexHighlight;
-    SdlSurface pathHighlight;
-
-    void loadTiles()
+    // All map images live in one atlas.  These refer to images by atlas id.
+    TextureAtlas atlas;
+    std::vector<int> tiles;
+    std::vector<int> edges;
+    std::vector<int> grassObstacles;
+    std::vector<int> dirtObstacles;
+    std::vector<int> sandObstacles;
+    std::vector<int> waterObstacles;
+    std::vector<int> swampObstacles;
+    std::vector<int> snowObstacles;
+    int hexHighlight = -1;
+
+    // Path hexes are shaded the same as hex-shadow.png, black at 1/4 opacity.
+    const SDL_Color pathShade = {0, 0, 0, 0};
+    const Uint8 pathShadeAlpha = 64;
+
+    // Movement ranges are lightly shaded with a solid border.
+    const SDL_Color rangeShade = {255, 255, 255, 0};
+    const Uint8 rangeShadeAlpha = 40;
+    const Uint8 rangeBorderAlpha = 192;
+
+    // Draw order within the map, lowest first.
+    const Uint16 zTile = 0;
+    const Uint16 zEdge = 1;
+    const Uint16 zObstacle = 2;
+    const Uint16 zRange = 3;
+    const Uint16 zPath = 4;
+    const Uint16 zSelected = 5;
+    static_assert(zSelected < RandomMap::zAboveMap,
+                  "map layers must stay below zAboveMap");
+
+    // Images are decoded in the background and added to the atlas in the
+    // order they were requested, so we know each one's id up front.
+    std::vector<std::future<SdlPixelBuffer>> pendingImages;
+
+    int loadImage(AssetLoader &loader, const char *filename)
     {
-        assert(SDL_WasInit(SDL_INIT_VIDEO));
-
-        // Load the tiles in the same order as Terrain enum.
-        if (tiles.empty()) {
-            tiles.emplace_back(sdlLoadImage("../img/grass.png"));
-            tiles.emplace_back(sdlLoadImage("../img/dirt.png"));
-            tiles.emplace_back(sdlLoadImage("../img/desert.png"));
-            tiles.emplace_back(sdlLoadImage("../img/water.png"));
-            tiles.emplace_back(sdlLoadImage("../img/swamp.png"));
-            tiles.emplace_back(sdlLoadImage("../img/snow.png"));
-        }
-        if (edges.empty()) {
-            edges.emplace_back(sdlLoadImage("../img/grass-n.png"));
-            edges.emplace_back(sdlLoadImage("../img/grass-ne.png"));
-            edges.emplace_back(sdlLoadImage("../img/grass-se.png"));
-            edges.emplace_back(sdlLoadImage("../img/grass-s.png"));
-            edges.emplace_back(sdlLoadImage("../img/grass-sw.png"));
-            edges.emplace_back(sdlLoadImage("../img/grass-nw.png"));
-            edges.emplace_back(sdlLoadImage("../img/dirt-n.png"));
-            edges.emplace_back(sdlLoadImage("../img/dirt-ne.png"));
-            edges.emplace_back(sdlLoadImage("../img/dirt-se.png"));
-            edges.emplace_back(sdlLoadImage("../img/dirt-s.png"));
-            edges.emplace_back(sdlLoadImage("../img/dirt-sw.png"));
-            edges.emplace_back(sdlLoadImage("../img/dirt-nw.png"));
-            edges.emplace_back(sdlLoadImage("../img/beach-n.png"));
-            edges.emplace_back(sdlLoadImage("../img/beach-ne.png"));
-            edges.emplace_back(sdlLoadImage("../img/beach-se.png"));
-            edges.emplace_back(sdlLoadImage("../img/beach-s.png"));
-            edges.emplace_back(sdlLoadImage("../img/beach-sw.png"));
-            edges.emplace_back(sdlLoadImage("../img/beach-nw.png"));
-        }
-        if (grassObstacles.empty()) {
-            grassObstacles.emplace_back(sdlLoadImage("../img/grass-trees-1.png"));
-            grassObstacles.emplace_back(sdlLoadImage("../img/grass-trees-2.png"));
-            grassObstacles.emplace_back(sdlLoadImage("../img/grass-trees-3.png"));
-        }
-        if (dirtObstacles.empty()) {
-            dirtObstacles.emplace_back(sdlLoadImage("../img/dirt-trees-1.png"));
-            dirtObstacles.emplace_back(sdlLoadImage("../img/dirt-trees-2.png"));
-            dirtObstacles.emplace_back(sdlLoadImage("../img/dirt-trees-3.png"));
-        }
-        if (sandObstacles.empty()) {
-            sandObstacles.emplace_back(sdlLoadImage("../img/desert-plants-1.png"));
-            sandObstacles.emplace_back(sdlLoadImage("../img/desert-plants-2.png"));
-            sandObstacles.emplace_back(sdlLoadImage("../img/desert-plants-3.png"));
-            sandObstacles.emplace_back(sdlLoadImage("../img/desert-plants-4.png"));
-        }
-        if (waterObstacles.empty()) {
-            waterObstacles.emplace_back(sdlLoadImage("../img/water-reef-1.png"));
-            waterObstacles.emplace_back(sdlLoadImage("../img/water-reef-2.png"));
-            waterObstacles.emplace_back(sdlLoadImage("../img/water-reef-3.png"));
-        }
-        if (swampObstacles.empty()) {
-            swampObstacles.emplace_back(sdlLoadImage("../img/swamp-mushrooms-1.png"));
-            swampObstacles.emplace_back(sdlLoadImage("../img/swamp-mushrooms-2.png"));
-            swampObstacles.emplace_back(sdlLoadImage("../img/swamp-mushrooms-3.png"));
-        }
-        if (snowObstacles.empty()) {
-            snowObstacles.emplace_back(sdlLoadImage("../img/snow-trees-1.png"));
-            snowObstacles.emplace_back(sdlLoadImage("../img/snow-trees-2.png"));
-            snowObstacles.emplace_back(sdlLoadImage("../img/snow-trees-3.png"));
-        }
-        if (!hexHighlight) {
-            hexHighlight = sdlLoadImage("../img/hex-yellow.png");
+        pendingImages.push_back(loader.loadImage(filename));
+        return atlas.size() + pendingImages.size() - 1;
+    }
+
+    // tilingWidth
+    // |   |
+    //  _     _
+    // / \_    tilingHeight
+    // \_/ \  _
+    //   \_/
+    const Sint16 tilingWidth = pHexSize * 3 / 2;
+    const Sint16 tilingHeight = pHexSize;
+
+    // The hex grid repeats every tilingWidth x tilingHeight pixels.  For each
+    // pixel within one tile, store the offset from the tile's base hex to the
+    // hex that pixel falls in.
+    struct HexTile
+    {
+        Sint8 dx[tilingHeight][tilingWidth];
+        Sint8 dy[tilingHeight][tilingWidth];
+    };
+
+    // source: Battle for Wesnoth, pixel_position_to_hex() in display.cpp.
+    Point hexOffsetInTile(Sint16 xMod, Sint16 yMod)
+    {
+        // I'm not going to pretend to know why this works.
+        if (yMod < tilingHeight / 2) {
+            if ((xMod * 2 + yMod) < (pHexSize / 2)) {
+                return {-1, -1};
+            }
+            else if ((xMod * 2 - yMod) < (pHexSize * 3 / 2)) {
+                return {0, 0};
+            }
+            else {
+                return {1, -1};
+            }
         }
-        if (!pathHighlight) {
-            pathHighlight = sdlLoadImage("../img/hex-shadow.png");
+        else {
+            if ((xMod * 2 - (yMod - pHexSize / 2)) < 0) {
+                return {-1, 0};
+            }
+            else if ((xMod * 2 + (yMod - pHexSize / 2)) < pHexSize * 2) {
+                return {0, 0};
+            }
+            else {
+                return {1, 0};
+            }
         }
     }
 
+    const HexTile & hexTile()
+    {
+        static const HexTile tile = [] {
+            HexTile t;
+            for (Sint16 y = 0; y < tilingHeight; ++y) {
+                for (Sint16 x = 0; x < tilingWidth; ++x) {
+                    auto offset = hexOffsetInTile(x, y);
+                    t.dx[y][x] = offset.first;
+                    t.dy[y][x] = offset.second;
+                }
+            }
+            return t;
+        }();
+        return tile;
+    }
+
     Point rectCorner(const SDL_Rect &rect, Dir d)
     {
         switch (d) {
@@ -125,9 +146,9 @@ namespace {
         }
     }
 
-    SdlSurface getObstacle(int terrain)
+    int getObstacle(int terrain)
     {
-        std::vector<SdlSurface> *choices = 0;
+        std::vector<int> *choices = 0;
         switch (terrain) {
             case GRASS:
                 choices = &grassObstacles;
@@ -156,6 +177,8 @@ namespace {
     }
 }
 
+const Uint16 RandomMap::zAboveMap;
+
 RandomMap::RandomMap(Sint16 hWidth, Sint16 hHeight, const SDL_Rect &pDisplayArea)
     : mgrid_(hWidth, hHeight),
     pWidth_(pHexSize * 3 / 4 * hWidth + pHexSize / 4),
@@ -165,6 +188,9 @@ RandomMap::RandomMap(Sint16 hWidth, Sint16 hHeight, const SDL_Rect &pDisplayArea
     centers_(),
     regionGraph_(numRegions_),
     regionGraphWalk_(numRegions_),
+    regionMin_(numRegions_, Point{Sint16_max, Sint16_max}),
+    regionMax_(numRegions_, Point{Sint16_min, Sint16_min}),
+    maxCenterHop_(1),
     tgrid_(hWidth + 2, hHeight + 2),
     terrain_(tgrid_.size()),
     tObst_(tgrid_.size(), 0),
@@ -174,7 +200,12 @@ RandomMap::RandomMap(Sint16 hWidth, Sint16 hHeight, const SDL_Rect &pDisplayArea
     mMaxY_(pHeight_ - pDisplayArea_.h),
     px_(0),
     py_(0),
-    selectedHex_(hInvalid)
+    selectedHex_(hInvalid),
+    selectedPath_(),
+    range_(),
+    rangeBorder_(),
+    onChange_([] (const std::vector<Point> &) {}),
+    drawList_(pDisplayArea)
 {
     assert(hWidth > 1);
 
@@ -183,10 +214,91 @@ RandomMap::RandomMap(Sint16 hWidth, Sint16 hHeight, const SDL_Rect &pDisplayArea
     generateObstacles();
     makeWalkable();
     buildRegionGraph();
+    measureRegions();
     assignTerrain();
     setObstacleImages();
 }
 
+void RandomMap::loadTiles()
+{
+    assert(SDL_WasInit(SDL_INIT_VIDEO));
+    if (atlas.size() > 0) {
+        return;
+    }
+    AssetLoader loader;
+
+    // Load the tiles in the same order as Terrain enum.
+    if (tiles.empty()) {
+        tiles.emplace_back(loadImage(loader, "../img/grass.png"));
+        tiles.emplace_back(loadImage(loader, "../img/dirt.png"));
+        tiles.emplace_back(loadImage(loader, "../img/desert.png"));
+        tiles.emplace_back(loadImage(loader, "../img/water.png"));
+        tiles.emplace_back(loadImage(loader, "../img/swamp.png"));
+        tiles.emplace_back(loadImage(loader, "../img/snow.png"));
+    }
+    if (edges.empty()) {
+        edges.emplace_back(loadImage(loader, "../img/grass-n.png"));
+        edges.emplace_back(loadImage(loader, "../img/grass-ne.png"));
+        edges.emplace_back(loadImage(loader, "../img/grass-se.png"));
+        edges.emplace_back(loadImage(loader, "../img/grass-s.png"));
+        edges.emplace_back(loadImage(loader, "../img/grass-sw.png"));
+        edges.emplace_back(loadImage(loader, "../img/grass-nw.png"));
+        edges.emplace_back(loadImage(loader, "../img/dirt-n.png"));
+        edges.emplace_back(loadImage(loader, "../img/dirt-ne.png"));
+        edges.emplace_back(loadImage(loader, "../img/dirt-se.png"));
+        edges.emplace_back(loadImage(loader, "../img/dirt-s.png"));
+        edges.emplace_back(loadImage(loader, "../img/dirt-sw.png"));
+        edges.emplace_back(loadImage(loader, "../img/dirt-nw.png"));
+        edges.emplace_back(loadImage(loader, "../img/beach-n.png"));
+        edges.emplace_back(loadImage(loader, "../img/beach-ne.png"));
+        edges.emplace_back(loadImage(loader, "../img/beach-se.png"));
+        edges.emplace_back(loadImage(loader, "../img/beach-s.png"));
+        edges.emplace_back(loadImage(loader, "../img/beach-sw.png"));
+        edges.emplace_back(loadImage(loader, "../img/beach-nw.png"));
+    }
+    if (grassObstacles.empty()) {
+        grassObstacles.emplace_back(loadImage(loader, "../img/grass-trees-1.png"));
+        grassObstacles.emplace_back(loadImage(loader, "../img/grass-trees-2.png"));
+        grassObstacles.emplace_back(loadImage(loader, "../img/grass-trees-3.png"));
+    }
+    if (dirtObstacles.empty()) {
+        dirtObstacles.emplace_back(loadImage(loader, "../img/dirt-trees-1.png"));
+        dirtObstacles.emplace_back(loadImage(loader, "../img/dirt-trees-2.png"));
+        dirtObstacles.emplace_back(loadImage(loader, "../img/dirt-trees-3.png"));
+    }
+    if (sandObstacles.empty()) {
+        sandObstacles.emplace_back(loadImage(loader, "../img/desert-plants-1.png"));
+        sandObstacles.emplace_back(loadImage(loader, "../img/desert-plants-2.png"));
+        sandObstacles.emplace_back(loadImage(loader, "../img/desert-plants-3.png"));
+        sandObstacles.emplace_back(loadImage(loader, "../img/desert-plants-4.png"));
+    }
+    if (waterObstacles.empty()) {
+        waterObstacles.emplace_back(loadImage(loader, "../img/water-reef-1.png"));
+        waterObstacles.emplace_back(loadImage(loader, "../img/water-reef-2.png"));
+        waterObstacles.emplace_back(loadImage(loader, "../img/water-reef-3.png"));
+    }
+    if (swampObstacles.empty()) {
+        swampObstacles.emplace_back(loadImage(loader, "../img/swamp-mushrooms-1.png"));
+        swampObstacles.emplace_back(loadImage(loader, "../img/swamp-mushrooms-2.png"));
+        swampObstacles.emplace_back(loadImage(loader, "../img/swamp-mushrooms-3.png"));
+    }
+    if (snowObstacles.empty()) {
+        snowObstacles.emplace_back(loadImage(loader, "../img/snow-trees-1.png"));
+        snowObstacles.emplace_back(loadImage(loader, "../img/snow-trees-2.png"));
+        snowObstacles.emplace_back(loadImage(loader, "../img/snow-trees-3.png"));
+    }
+    if (hexHighlight < 0) {
+        hexHighlight = loadImage(loader, "../img/hex-yellow.png");
+    }
+
+    // Only the conversion to display format has to happen here.
+    for (auto &f : pendingImages) {
+        atlas.add(sdlDisplayFormat(f.get()));
+    }
+    pendingImages.clear();
+    atlas.pack();
+}
+
 Sint16 RandomMap::pWidth() const
 {
     return pWidth_;
@@ -208,6 +320,13 @@ Point RandomMap::maxPixel() const
 }
 
 void RandomMap::draw(Sint16 mpx, Sint16 mpy)
+{
+    draw(drawList_, mpx, mpy);
+    sdlClear(pDisplayArea_);
+    drawList_.draw();
+}
+
+void RandomMap::draw(DrawList &list, Sint16 mpx, Sint16 mpy)
 {
     assert(mpx >= 0 && mpx <= mMaxX_ && mpy >= 0 && mpy <= mMaxY_);
 
@@ -226,39 +345,42 @@ void RandomMap::draw(Sint16 mpx, Sint16 mpy)
     seHex.first = std::min<Sint16>(seHex.first + 1, mgrid_.width());
     seHex.second = std::min<Sint16>(seHex.second + 1, mgrid_.height());
 
-    SdlSetClipRect(pDisplayArea_, [this, &nwHex, &seHex]
-    {
-        sdlClear(pDisplayArea_);
-
-        for (Sint16 hx = nwHex.first; hx <= seHex.first; ++hx) {
-            for (Sint16 hy = nwHex.second; hy <= seHex.second; ++hy) {
-                drawTile(hx, hy);
-            }
-        }
-        for (Sint16 hx = nwHex.first; hx <= seHex.first; ++hx) {
-            for (Sint16 hy = nwHex.second; hy <= seHex.second; ++hy) {
-                drawObstacle(hx, hy);
-            }
+    // The list sorts by layer, so each hex can be added in a single pass.
+    for (Sint16 hx = nwHex.first; hx <= seHex.first; ++hx) {
+        for (Sint16 hy = nwHex.second; hy <= seHex.second; ++hy) {
+            drawTile(list, hx, hy);
+            drawObstacle(list, hx, hy);
         }
+    }
 
-        for (auto node : selectedPath_) {
-            Sint16 spx = 0;
-            Sint16 spy = 0;
-            std::tie(spx, spy) = sPixel(node);
-            std::cerr << node << " (" << spx << ',' << spy << "); ";
-            sdlBlit(pathHighlight, spx, spy);
-        }
-        if (!selectedPath_.empty()) {
-            std::cerr << '\n';
-        }
+    for (auto aIndex : range_) {
+        Sint16 spx = 0;
+        Sint16 spy = 0;
+        std::tie(spx, spy) = sPixel(aIndex);
+        list.addTint(sdlHexMask(), spx, spy, rangeShade, rangeShadeAlpha,
+                     zRange);
+    }
+    for (const auto &edge : rangeBorder_) {
+        Sint16 spx = 0;
+        Sint16 spy = 0;
+        std::tie(spx, spy) = sPixel(edge.first);
+        list.addTint(sdlHexEdgeMask(edge.second), spx, spy, rangeShade,
+                     rangeBorderAlpha, zRange);
+    }
 
-        if (selectedHex_ != hInvalid) {
-            Sint16 spx = 0;
-            Sint16 spy = 0;
-            std::tie(spx, spy) = sPixelFromHex(selectedHex_);
-            sdlBlit(hexHighlight, spx, spy);
-        }
-    });
+    for (auto node : selectedPath_) {
+        Sint16 spx = 0;
+        Sint16 spy = 0;
+        std::tie(spx, spy) = sPixel(node);
+        list.addTint(sdlHexMask(), spx, spy, pathShade, pathShadeAlpha, zPath);
+    }
+
+    if (selectedHex_ != hInvalid) {
+        Sint16 spx = 0;
+        Sint16 spy = 0;
+        std::tie(spx, spy) = sPixelFromHex(selectedHex_);
+        atlas.draw(list, hexHighlight, spx, spy, zSelected);
+    }
 }
 
 void RandomMap::redraw()
@@ -285,52 +407,15 @@ Point RandomMap::getHexAtS(const Point &sp) const
     return getHexAtM(mPixel(sp));
 }
 
-// source: Battle for Wesnoth, pixel_position_to_hex() in display.cpp.
 Point RandomMap::getHexAtM(Sint16 mpx, Sint16 mpy) const
 {
     assert(mpx >= 0 && mpx < pWidth_ && mpy >= 0 && mpy < pHeight_);
 
-    // tilingWidth
-    // |   |
-    //  _     _
-    // / \_    tilingHeight
-    // \_/ \  _
-    //   \_/
-    const Sint16 tilingWidth = pHexSize * 3 / 2;
-    const Sint16 tilingHeight = pHexSize;
-
-    // I'm not going to pretend to know why the rest of this works.
-    Sint16 hx = mpx / tilingWidth * 2;
+    const auto &tile = hexTile();
     Sint16 xMod = mpx % tilingWidth;
-    Sint16 hy = mpy / tilingHeight;
     Sint16 yMod = mpy % tilingHeight;
-
-    if (yMod < tilingHeight / 2) {
-        if ((xMod * 2 + yMod) < (pHexSize / 2)) {
-            --hx;
-            --hy;
-        }
-        else if ((xMod * 2 - yMod) < (pHexSize * 3 / 2)) {
-            // do nothing
-        }
-        else {
-            ++hx;
-            --hy;
-        }
-    }
-    else {
-        if ((xMod * 2 - (yMod - pHexSize / 2)) < 0) {
-            --hx;
-        }
-        else if ((xMod * 2 + (yMod - pHexSize / 2)) < pHexSize * 2) {
-            // do nothing
-        }
-        else {
-            ++hx;
-        }
-    }
-
-    return {hx, hy};
+    return {static_cast<Sint16>(mpx / tilingWidth * 2 + tile.dx[yMod][xMod]),
+            static_cast<Sint16>(mpy / tilingHeight + tile.dy[yMod][xMod])};
 }
 
 Point RandomMap::getHexAtM(const Point &mp) const
@@ -340,9 +425,7 @@ Point RandomMap::getHexAtM(const Point &mp) const
 
 Point RandomMap::sPixelFromHex(Sint16 hx, Sint16 hy) const
 {
-    Sint16 mpx = hx * pHexSize * 0.75;
-    Sint16 mpy = (hy + 0.5 * abs(hx % 2)) * pHexSize;
-    return sPixel(mpx, mpy);
+    return sPixel(mPixelFromHex({hx, hy}));
 }
 
 Point RandomMap::sPixelFromHex(const Point &hex) const
@@ -350,12 +433,60 @@ Point RandomMap::sPixelFromHex(const Point &hex) const
     return sPixelFromHex(hex.first, hex.second);
 }
 
+Point RandomMap::mPixelFromHex(const Point &hex) const
+{
+    Sint16 mpx = hex.first * pHexSize * 0.75;
+    Sint16 mpy = (hex.second + 0.5 * abs(hex.first % 2)) * pHexSize;
+    return {mpx, mpy};
+}
+
 int RandomMap::getTerrainAt(Sint16 mpx, Sint16 mpy) const
 {
     Point mHex = getHexAtM(mpx, mpy);
     return terrain_[tIndex(mHex)];
 }
 
+int RandomMap::getTerrain(const Point &hex) const
+{
+    if (mgrid_.offGrid(hex)) {
+        return -1;
+    }
+
+    return terrain_[tIndex(hex)];
+}
+
+void RandomMap::setTerrain(const Point &hex, int terrain)
+{
+    assert(terrain >= 0 && terrain < NUM_TERRAINS);
+    if (mgrid_.offGrid(hex) || getTerrain(hex) == terrain) {
+        return;
+    }
+
+    auto tIdx = tIndex(hex);
+    terrain_[tIdx] = terrain;
+    if (tObst_[tIdx]) {
+        setObstacleImage(tIdx);
+    }
+
+    // Hexes on the edge of the map are mirrored by the adjacent hexes
+    // just outside of it.
+    mirrorEdges();
+    for (auto d : Dir()) {
+        auto n = adjacent(hex, d);
+        auto nIdx = tIndex(n);
+        if (mgrid_.offGrid(n) && nIdx != -1 && tObst_[nIdx]) {
+            setObstacleImage(nIdx);
+        }
+    }
+
+    onChange_({hex});
+}
+
+void RandomMap::onChange(std::function<void (const std::vector<Point> &)> func)
+{
+    onChange_ = func;
+}
+
 void RandomMap::selectHex(const Point &hex)
 {
     if (!mgrid_.offGrid(hex)) {
@@ -430,6 +561,80 @@ void RandomMap::highlightPath(const Point &hSrc, const Point &hDest)
     }
 }
 
+std::vector<Point> RandomMap::reachableWithin(const Point &hex, int budget,
+    std::function<int (const Point &)> costFn) const
+{
+    std::vector<Point> reached;
+    if (budget < 0 || !walkable(hex)) {
+        return reached;
+    }
+
+    // Dial's algorithm.  Costs are small integers, so instead of a priority
+    // queue we keep a list of hexes for each possible total cost and work
+    // through them in order.  A hex's cost is final by the time its list comes
+    // up.  A hex can be listed more than once if we find a cheaper way to it;
+    // the stale entries are skipped.  Nothing past the budget is ever listed,
+    // so the search only touches hexes in range and their neighbors.
+    std::vector<int> cost(mgrid_.size(), -1);
+    std::vector<std::vector<int>> buckets(budget + 1);
+    auto aSrc = mgrid_.aryFromHex(hex);
+    cost[aSrc] = 0;
+    buckets[0].push_back(aSrc);
+
+    for (int c = 0; c <= budget; ++c) {
+        // Moves that cost 0 add to the list we're working on, so index
+        // instead of using iterators.
+        auto &bucket = buckets[c];
+        for (unsigned i = 0; i < bucket.size(); ++i) {
+            auto aIndex = bucket[i];
+            if (cost[aIndex] != c) continue;
+            reached.push_back(mgrid_.hexFromAry(aIndex));
+
+            for (auto d : Dir()) {
+                auto n = mgrid_.aryGetNeighbor(aIndex, d);
+                if (n < 0 || !walkable(n)) continue;
+
+                auto step = costFn ? costFn(mgrid_.hexFromAry(n)) :
+                    moveCost(n);
+                if (step < 0) continue;
+                auto nCost = c + step;
+                if (nCost > budget) continue;
+                if (cost[n] == -1 || nCost < cost[n]) {
+                    cost[n] = nCost;
+                    buckets[nCost].push_back(n);
+                }
+            }
+        }
+        std::vector<int>().swap(bucket);
+    }
+
+    return reached;
+}
+
+void RandomMap::highlightRange(const std::vector<Point> &hexes)
+{
+    range_.clear();
+    rangeBorder_.clear();
+
+    std::vector<char> inRange(mgrid_.size(), 0);
+    for (const auto &hex : hexes) {
+        auto aIndex = mgrid_.aryFromHex(hex);
+        if (aIndex < 0 || aIndex >= mgrid_.size() || inRange[aIndex]) continue;
+        inRange[aIndex] = 1;
+        range_.push_back(aIndex);
+    }
+
+    // The border is every edge between a hex in range and one that isn't.
+    for (auto aIndex : range_) {
+        for (auto d : Dir()) {
+            auto n = mgrid_.aryGetNeighbor(aIndex, d);
+            if (n < 0 || !inRange[n]) {
+                rangeBorder_.emplace_back(aIndex, d);
+            }
+        }
+    }
+}
+
 bool RandomMap::walkable(const Point &hex) const
 {
     return walkable(mgrid_.aryFromHex(hex));
@@ -444,6 +649,30 @@ bool RandomMap::walkable(int mIndex) const
     return tObst_[tIndex(mIndex)] == 0;
 }
 
+int RandomMap::moveCost(int mIndex) const
+{
+    return getMoveCost(terrain_[tIndex(mIndex)]);
+}
+
+int RandomMap::distToRegion(int mIndex, int region) const
+{
+    // The nearest hex in the bounding box is straight across in the nearest
+    // column.
+    auto hex = mgrid_.hexFromAry(mIndex);
+    const auto &rMin = regionMin_[region];
+    const auto &rMax = regionMax_[region];
+    Point nearest = {std::min(std::max(hex.first, rMin.first), rMax.first),
+                     std::min(std::max(hex.second, rMin.second), rMax.second)};
+    return hexDist(hex, nearest);
+}
+
+int RandomMap::regionHopsLeft(int rBegin, int rEnd) const
+{
+    // Each hop brings us at most maxCenterHop_ closer to the goal's center.
+    auto dist = hexDist(centers_[rBegin], centers_[rEnd]);
+    return (dist + maxCenterHop_ - 1) / maxCenterHop_;
+}
+
 void RandomMap::generateRegions()
 {
     // Start with a set of random hexes.  Don't worry if there are duplicates.
@@ -452,19 +681,29 @@ void RandomMap::generateRegions()
                [this] { return mgrid_.hexRandom(); });
 
     // Find the closest center to each hex on the map.  The set of hexes
-    // closest to center #0 will be region 0, etc.  Repeat this several times
-    // for more regular-looking regions.
-    for (int i = 0; i < 4; ++i) {
+    // closest to center #0 will be region 0, etc.  findClosest() is fastest
+    // with the x and y coordinates of the centers in separate arrays.
+    std::vector<Sint16> cx(numRegions_);
+    std::vector<Sint16> cy(numRegions_);
+    auto assignRegions = [&] {
+        for (int r = 0; r < numRegions_; ++r) {
+            cx[r] = centers_[r].first;
+            cy[r] = centers_[r].second;
+        }
         for (int aIndex = 0; aIndex < mgrid_.size(); ++aIndex) {
-            regions_[aIndex] = findClosest(mgrid_.hexFromAry(aIndex), centers_);
+            regions_[aIndex] = findClosest(mgrid_.hexFromAry(aIndex),
+                                           cx.data(), cy.data(), numRegions_);
         }
+    };
+
+    // Repeat this several times for more regular-looking regions.
+    for (int i = 0; i < 4; ++i) {
+        assignRegions();
         recalcHexCenters();
     }
 
     // Assign each hex to its final region.
-    for (int aIndex = 0; aIndex < mgrid_.size(); ++aIndex) {
-        regions_[aIndex] = findClosest(mgrid_.hexFromAry(aIndex), centers_);
-    }
+    assignRegions();
 }
 
 void RandomMap::recalcHexCenters()
@@ -521,13 +760,25 @@ void RandomMap::buildRegionGraph()
             }
         }
     }
+}
 
-    // XXX
-    for (auto i = 0u; i < regionGraphWalk_.size(); ++i) {
-        std::cout << i << ": ";
-        copy(std::begin(regionGraphWalk_[i]), std::end(regionGraphWalk_[i]),
-             std::ostream_iterator<int>(std::cout, ", "));
-        std::cout << "\n";
+void RandomMap::measureRegions()
+{
+    for (int i = 0; i < mgrid_.size(); ++i) {
+        auto hex = mgrid_.hexFromAry(i);
+        auto &rMin = regionMin_[regions_[i]];
+        auto &rMax = regionMax_[regions_[i]];
+        rMin.first = std::min(rMin.first, hex.first);
+        rMin.second = std::min(rMin.second, hex.second);
+        rMax.first = std::max(rMax.first, hex.first);
+        rMax.second = std::max(rMax.second, hex.second);
+    }
+
+    for (int r = 0; r < numRegions_; ++r) {
+        for (auto rNeighbor : regionGraphWalk_[r]) {
+            maxCenterHop_ = std::max(maxCenterHop_,
+                                     hexDist(centers_[r], centers_[rNeighbor]));
+        }
     }
 }
 
@@ -565,6 +816,11 @@ void RandomMap::assignTerrain()
         terrain_[tIdx] = rTerrain[regions_[i]];
     }
 
+    mirrorEdges();
+}
+
+void RandomMap::mirrorEdges()
+{
     // Corners of the terrain grid mirror those of the main grid.
     auto nw = tgrid_.aryCorner(Dir::NW);
     auto nwMirror = tIndex(mgrid_.aryCorner(Dir::NW));
@@ -619,20 +875,24 @@ void RandomMap::setObstacleImages()
 {
     for (auto i = 0u; i < tObstImg_.size(); ++i) {
         if (tObst_[i] == 0) continue;
-
-        Obstacle &o = tObstImg_[i];
-        o.img = getObstacle(terrain_[i]);
-        o.pxOffset = (pHexSize - o.img->w) / 2;
-        o.pyOffset = (pHexSize - o.img->h) / 2;
-
-        // Shift the graphics a tiny bit for a less gridded look.
-        std::uniform_int_distribution<Sint16> dist(-3, 3);
-        o.pxOffset += dist(randomGenerator());
-        o.pyOffset += dist(randomGenerator());
+        setObstacleImage(i);
     }
 }
 
-void RandomMap::drawTile(Sint16 hx, Sint16 hy)
+void RandomMap::setObstacleImage(int tIdx)
+{
+    Obstacle &o = tObstImg_[tIdx];
+    o.img = getObstacle(terrain_[tIdx]);
+    o.pxOffset = (pHexSize - atlas.width(o.img)) / 2;
+    o.pyOffset = (pHexSize - atlas.height(o.img)) / 2;
+
+    // Shift the graphics a tiny bit for a less gridded look.
+    std::uniform_int_distribution<Sint16> dist(-3, 3);
+    o.pxOffset += dist(randomGenerator());
+    o.pyOffset += dist(randomGenerator());
+}
+
+void RandomMap::drawTile(DrawList &list, Sint16 hx, Sint16 hy)
 {
     Sint16 spx = 0;
     Sint16 spy = 0;
@@ -640,7 +900,7 @@ void RandomMap::drawTile(Sint16 hx, Sint16 hy)
     auto tIdx = tIndex(hx, hy);
     auto terrainType = terrain_[tIdx];
 
-    sdlBlit(tiles[terrainType], spx, spy);
+    atlas.draw(list, tiles[terrainType], spx, spy, zTile);
 
     // Draw edge transitions for each neighboring tile.
     for (auto dir : Dir()) {
@@ -650,12 +910,12 @@ void RandomMap::drawTile(Sint16 hx, Sint16 hy)
         auto edgeType = getEdge(terrainType, terrain_[neighborIndex]);
         if (edgeType >= 0) {
             int e = edgeType * 6 + int(dir);
-            sdlBlit(edges[e], spx, spy);
+            atlas.draw(list, edges[e], spx, spy, zEdge);
         }
     }
 }
 
-void RandomMap::drawObstacle(Sint16 hx, Sint16 hy)
+void RandomMap::drawObstacle(DrawList &list, Sint16 hx, Sint16 hy)
 {
     Sint16 spx = 0;
     Sint16 spy = 0;
@@ -663,8 +923,8 @@ void RandomMap::drawObstacle(Sint16 hx, Sint16 hy)
     auto tIdx = tIndex(hx, hy);
 
     if (tObst_[tIdx]) {
-        sdlBlit(tObstImg_[tIdx].img, spx + tObstImg_[tIdx].pxOffset,
-                spy + tObstImg_[tIdx].pyOffset);
+        atlas.draw(list, tObstImg_[tIdx].img, spx + tObstImg_[tIdx].pxOffset,
+                   spy + tObstImg_[tIdx].pyOffset, zObstacle);
     }
 }
 
@@ -689,78 +949,108 @@ void RandomMap::makeWalkable()
         }
     }
 
-    // Build a list of walkable hexes in each region.
-    std::vector<std::vector<int>> walkByReg(numRegions_);
-    for (auto i = 0u; i < regions_.size(); ++i) {
-        if (walkable(i)) {
-            auto r = regions_[i];
-            walkByReg[r].push_back(i);
+    // Label each group of walkable hexes that are connected without leaving
+    // their region.  Hexes are marked as they're queued so none is queued
+    // twice.
+    const int size = mgrid_.size();
+    std::vector<int> group(size, -1);
+    std::vector<int> groupSize;
+    for (int i = 0; i < size; ++i) {
+        if (!walkable(i) || group[i] != -1) continue;
+
+        int g = groupSize.size();
+        groupSize.push_back(0);
+        group[i] = g;
+        std::queue<int> q;
+        q.push(i);
+        while (!q.empty()) {
+            auto hex = q.front();
+            q.pop();
+            ++groupSize[g];
+            for (auto n : mgrid_.aryNeighbors(hex)) {
+                if (regions_[n] == regions_[hex] && walkable(n) &&
+                    group[n] == -1)
+                {
+                    group[n] = g;
+                    q.push(n);
+                }
+            }
         }
     }
 
-    // Keep track of all hexes we can reach through multiple function calls.
-    std::vector<char> visited(regions_.size(), 0);
-    
-    for (auto i = 0; i < numRegions_; ++i) {
-        if (!walkByReg[i].empty()) {
-            makeRegionWalkable(walkByReg[i], visited);
+    // The largest group in each region stays as it is.  Every other group
+    // gets connected to it.
+    std::vector<int> mainGroup(numRegions_, -1);
+    for (int i = 0; i < size; ++i) {
+        auto g = group[i];
+        if (g == -1) continue;
+
+        auto &m = mainGroup[regions_[i]];
+        if (m == -1 || groupSize[g] > groupSize[m]) {
+            m = g;
         }
     }
-}
 
-void RandomMap::makeRegionWalkable(std::vector<int> &hexes,
-                                   std::vector<char> &visited)
-{
-    // Helper function that returns all neighbors of a hex within the same
-    // region.
-    auto nbrsSameReg = [this] (int aIndex) {
-        std::vector<int> nbrs;
-        for (auto n : mgrid_.aryNeighbors(aIndex)) {
-            if (regions_[n] == regions_[aIndex]) {
-                nbrs.push_back(n);
+    // Search outward from every main group at once without leaving the
+    // region.  The cost of a path is the number of obstacles it would clear,
+    // so walking onto a hex is free.  With costs of only 0 and 1 a deque works
+    // as the priority queue: free moves go on the front, the rest on the back
+    // (0-1 BFS).  The first hex of any other group to come off the deque is
+    // the one that's cheapest to connect.
+    std::vector<int> cost(size, -1);
+    std::vector<int> prev(size, -1);
+    std::vector<char> done(size, 0);
+    std::deque<int> open;
+    for (int i = 0; i < size; ++i) {
+        if (group[i] != -1 && group[i] == mainGroup[regions_[i]]) {
+            cost[i] = 0;
+            open.push_back(i);
+        }
+    }
+
+    std::vector<char> groupFound(groupSize.size(), 0);
+    std::vector<int> closest;  // where to connect each other group
+    while (!open.empty()) {
+        auto hex = open.front();
+        open.pop_front();
+        if (done[hex]) continue;
+        done[hex] = 1;
+
+        auto g = group[hex];
+        if (g != -1 && groupFound[g] == 0) {
+            groupFound[g] = 1;
+            if (g != mainGroup[regions_[hex]]) {
+                closest.push_back(hex);
             }
         }
-        return nbrs;
-    };
 
-    // Breadth-first search from the first walkable hex in each region.  If
-    // the regions are open, we should reach every hex this way.
-    std::queue<int> q;
-    q.push(hexes[0]);
-    while (!q.empty()) {
-        auto hex = q.front();
-        visited[hex] = 1;
-        for (auto n : nbrsSameReg(hex)) {
-            if (walkable(n) && visited[n] == 0) {
-                q.push(n);
+        for (auto n : mgrid_.aryNeighbors(hex)) {
+            if (regions_[n] != regions_[hex] || done[n]) continue;
+
+            auto step = walkable(n) ? 0 : 1;
+            if (cost[n] == -1 || cost[hex] + step < cost[n]) {
+                cost[n] = cost[hex] + step;
+                prev[n] = hex;
+                if (step == 0) {
+                    open.push_front(n);
+                }
+                else {
+                    open.push_back(n);
+                }
             }
         }
-        q.pop();
     }
 
-    // Were any hexes not visited by the search?
-    auto notFound = find_if(std::begin(hexes), std::end(hexes),
-                            [&] (int hex) { return visited[hex] == 0; });
-    if (notFound == std::end(hexes)) return;
-
-    // Starting from a hex we couldn't reach, find a path to the nearest
-    // walkable hex already visited in this region.
-    Pathfinder pf;
-    pf.setNeighbors(nbrsSameReg);
-    pf.setGoal([this, &visited] (int node) {
-        return visited[node] == 1 && walkable(node);
-    });
-    auto path = pf.getPathFrom(*notFound);
-
-    // Clear this path of obstacles.
-    for (auto n : path) {
-        tObst_[tIndex(n)] = 0;
-        visited[n] = 1;
+    // Clear the obstacles on the way back to each main group.  Paths to
+    // different groups often share the same start, so stop at any hex we've
+    // already cleared.
+    std::vector<char> cleared(size, 0);
+    for (auto hex : closest) {
+        for (auto h = hex; h != -1 && cleared[h] == 0; h = prev[h]) {
+            cleared[h] = 1;
+            tObst_[tIndex(h)] = 0;
+        }
     }
-    
-    // Start over with the hex that wasn't found last time.
-    iter_swap(std::begin(hexes), notFound);
-    makeRegionWalkable(hexes, visited);
 }
 
 int RandomMap::tIndex(int mIndex) const
@@ -818,6 +1108,8 @@ std::vector<int> RandomMap::getRegionPath(int rBegin, int rEnd) const
     Pathfinder pf;
     pf.setNeighbors([this] (int n) { return regionGraphWalk_[n]; });
     pf.setGoal(rEnd);
+    pf.setEstimate([this, rEnd] (int n) { return regionHopsLeft(n, rEnd); });
+    pf.setMaxStepCost(1);
     return pf.getPathFrom(rBegin);
 }
 
@@ -847,10 +1139,13 @@ std::vector<int> RandomMap::getPath(int aSrc, int aDest) const
 
     Pathfinder pf;
     pf.setNeighbors(stayInDestReg);
+    pf.setStepCost([this] (int, int n) { return moveCost(n); });
+    pf.setMaxStepCost(maxMoveCost);
     pf.setGoal(aDest);
-
-    std::cout << "NEW PATH FROM " << aSrc << " (REGION " << rSrc << ") TO " <<
-        rDest << "(REGION " << rDest << ")\n";
+    auto hDest = mgrid_.hexFromAry(aDest);
+    pf.setEstimate([this, hDest] (int n) {
+        return hexDist(mgrid_.hexFromAry(n), hDest);
+    });
     return pf.getPathFrom(aSrc);
 }
 
@@ -873,9 +1168,9 @@ std::vector<int> RandomMap::getPathToReg(int aSrc, int rDest) const
 
     Pathfinder pf;
     pf.setNeighbors(sameOrAdjReg);
+    pf.setStepCost([this] (int, int n) { return moveCost(n); });
+    pf.setMaxStepCost(maxMoveCost);
     pf.setGoal([this, rDest] (int n) { return regions_[n] == rDest; });
-
-    std::cout << "NEW PATH FROM " << aSrc << " (REGION " << regions_[aSrc] <<
-       ") TO REGION " << rDest << "\n";
+    pf.setEstimate([this, rDest] (int n) { return distToRegion(n, rDest); });
     return pf.getPathFrom(aSrc);
 }
@@ -13,10 +13,12 @@
 #ifndef RANDOM_MAP_H
 #define RANDOM_MAP_H
 
+#include "DrawList.h"
 #include "HexGrid.h"
 #include "hex_utils.h"
 #include "sdl_helper.h"
 #include "terrain.h"
+#include <functional>
 #include <vector>
 
 class RandomMap
@@ -26,6 +28,11 @@ public:
     // is 2x1.
     RandomMap(Sint16 hWidth, Sint16 hHeight, const SDL_Rect &pDisplayArea);
 
+    // Load the map images.  This converts them to the display format, so it
+    // must be done on the main thread.  The constructor will call this if
+    // needed, but call it first if you construct a map on another thread.
+    static void loadTiles();
+
     // Size of the entire map in pixels.
     Sint16 pWidth() const;
     Sint16 pHeight() const;
@@ -40,6 +47,12 @@ public:
     void draw(Sint16 mpx, Sint16 mpy);
     void redraw();  // use last draw position
 
+    // Add the map to a draw list instead of drawing it right away, so other
+    // sprites can be drawn along with it.  The map uses z values below
+    // zAboveMap.  The list's view should be the display area.
+    void draw(DrawList &list, Sint16 mpx, Sint16 mpy);
+    static const Uint16 zAboveMap = 6;
+
     // Return the last draw() target.
     Point mDrawnAt() const;
 
@@ -53,15 +66,40 @@ public:
     Point sPixelFromHex(Sint16 hx, Sint16 hy) const;
     Point sPixelFromHex(const Point &hex) const;
 
+    // Return the map coordinates of the given hex.
+    Point mPixelFromHex(const Point &hex) const;
+
     // Get the terrain type at the given map coordinates.
     int getTerrainAt(Sint16 mpx, Sint16 mpy) const;
 
+    // Change the terrain of a hex.  Any obstacle on that hex gets a new image
+    // to match.  getTerrain() returns -1 if the hex is off the map.
+    int getTerrain(const Point &hex) const;
+    void setTerrain(const Point &hex, int terrain);
+
+    // Call a function with the list of hexes whenever the map is edited.
+    // void (const std::vector<Point> &hexes)
+    void onChange(std::function<void (const std::vector<Point> &)> func);
+
     // Highlight the given hex.
     void selectHex(const Point &hex);
     Point getSelectedHex() const;
 
     void highlightPath(const Point &hSrc, const Point &hDest);
 
+    // Return every hex that can be reached from the given hex while spending
+    // at most 'budget' movement points, including the starting hex.  The cost
+    // function returns the cost of entering a hex, or -1 if it can't be
+    // entered.  Without one, moves cost the same as they do when finding a
+    // path (see getMoveCost()).  Obstacles are never walkable.
+    // int (const Point &hex) -> cost of moving onto hex.
+    std::vector<Point> reachableWithin(const Point &hex, int budget,
+        std::function<int (const Point &)> costFn = nullptr) const;
+
+    // Shade a set of hexes and outline its border, such as a movement range.
+    // Pass an empty list to clear it.
+    void highlightRange(const std::vector<Point> &hexes);
+
     // Return true if the given hex doesn't have an obstacle.
     bool walkable(const Point &hex) const;
 
@@ -73,16 +111,23 @@ private:
     // Construct an adjacency list for each region.
     void buildRegionGraph();
 
+    // Find the bounding box of each region and how far apart the centers of
+    // adjacent regions can be.  These bound the distance left to go when
+    // finding paths.
+    void measureRegions();
+
     void generateObstacles();
     void assignTerrain();
+    void mirrorEdges();
     void setObstacleImages();
-    void drawTile(Sint16 hx, Sint16 hy);
-    void drawObstacle(Sint16 hx, Sint16 hy);
+    void setObstacleImage(int tIdx);
+    void drawTile(DrawList &list, Sint16 hx, Sint16 hy);
+    void drawObstacle(DrawList &list, Sint16 hx, Sint16 hy);
 
     // Ensure all walkable hexes in each region are reachable from every other
-    // walkable hex.
+    // walkable hex.  Each cut-off group of hexes is joined to the rest of its
+    // region by the path that clears the fewest obstacles.
     void makeWalkable();
-    void makeRegionWalkable(std::vector<int> &hexes, std::vector<char> &visited);
 
     // The terrain grid extends from (-1,-1) to (hWidth,hHeight) inclusive on
     // the main grid.  These conversions let us always refer to the map in main
@@ -100,6 +145,14 @@ private:
 
     bool walkable(int mIndex) const;
 
+    // Cost of moving onto a hex, based on its terrain.
+    int moveCost(int mIndex) const;
+
+    // Lower bounds on the cost of a path, for use as Pathfinder estimates.
+    // Every move costs at least 1, so the number of steps is a lower bound.
+    int distToRegion(int mIndex, int region) const;
+    int regionHopsLeft(int rBegin, int rEnd) const;
+
     // Find shortest number of hops between regions.  Intended as a high-level
     // first pass at generating paths between distant hexes.
     std::vector<int> getRegionPath(int rBegin, int rEnd) const;
@@ -119,6 +172,9 @@ private:
     std::vector<Point> centers_;  // center hex of each region
     AdjacencyList regionGraph_;
     AdjacencyList regionGraphWalk_;  // walkable paths to adjacent regions
+    std::vector<Point> regionMin_;  // bounding box of each region
+    std::vector<Point> regionMax_;
+    Sint16 maxCenterHop_;  // farthest distance between adjacent centers
 
     // To help make the edges of the map look nice, we extend the grid by one
     // hex in every direction.
@@ -130,9 +186,9 @@ private:
     {
         Sint16 pxOffset;  // handle images not sized exactly to one hex
         Sint16 pyOffset;
-        SdlSurface img;
+        int img;  // atlas id
         
-        Obstacle() : pxOffset(0), pyOffset(0), img() {}
+        Obstacle() : pxOffset(0), pyOffset(0), img(-1) {}
     };
     std::vector<Obstacle> tObstImg_;  // which obstacle graphics to use
 
@@ -148,6 +204,11 @@ private:
 
     Point selectedHex_;
     std::vector<int> selectedPath_;
+    std::vector<int> range_;
+    std::vector<std::pair<int, Dir>> rangeBorder_;  // hex, edge
+
+    std::function<void (const std::vector<Point> &)> onChange_;
+    DrawList drawList_;  // reused by draw() so it keeps its capacity
 };
 
 #endif
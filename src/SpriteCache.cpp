@@ -0,0 +1,133 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "SpriteCache.h"
+#include <cassert>
+
+SpriteCache::SpriteCache(const SdlRecolor &recolor, size_t budgetBytes)
+    : recolor_(recolor),
+    budget_(budgetBytes),
+    used_(0),
+    images_(),
+    lru_()
+{
+}
+
+SdlSurface SpriteCache::get(const std::string &path, int palette, bool flip,
+                            int numFrames)
+{
+    assert(numFrames > 0);
+
+    // Unflipped images are stored with 0 frames so the frame count doesn't
+    // make otherwise identical keys different.
+    Key key{path, palette, flip ? numFrames : 0};
+    auto iter = images_.find(key);
+    if (iter != std::end(images_)) {
+        // Move to the front of the LRU list.
+        lru_.splice(std::begin(lru_), lru_, iter->second.lruPos);
+        return iter->second.img;
+    }
+
+    auto img = build(path, palette, std::get<2>(key));
+    if (!img) {
+        return nullptr;
+    }
+
+    insert(key, img);
+    return img;
+}
+
+void SpriteCache::preload(AssetLoader &loader,
+                          const std::vector<std::string> &paths)
+{
+    std::vector<std::future<SdlPixelBuffer>> pending;
+    for (const auto &p : paths) {
+        pending.push_back(loader.loadImage(p));
+    }
+
+    for (auto i = 0u; i < paths.size(); ++i) {
+        Key key{paths[i], -1, 0};
+        auto img = sdlDisplayFormat(pending[i].get());
+        if (img && images_.find(key) == std::end(images_)) {
+            insert(key, img);
+        }
+    }
+}
+
+size_t SpriteCache::memoryUsed() const
+{
+    return used_;
+}
+
+void SpriteCache::setBudget(size_t budgetBytes)
+{
+    budget_ = budgetBytes;
+    if (!lru_.empty()) {
+        evict(lru_.front());
+    }
+}
+
+SdlSurface SpriteCache::build(const std::string &path, int palette,
+                              int flipFrames)
+{
+    // Start from the base image.  It goes through the cache too, so teams
+    // that share a unit only load it once.
+    if (palette < 0 && flipFrames == 0) {
+        return sdlLoadImage(path.c_str());
+    }
+    auto base = get(path);
+    if (!base) {
+        return nullptr;
+    }
+
+    SdlSurface img;
+    if (flipFrames == 1) {
+        img = sdlFlipH(base);
+    }
+    else if (flipFrames > 1) {
+        img = sdlFlipSheetH(base, flipFrames);
+    }
+    else {
+        img = sdlCopySurface(base);
+    }
+
+    if (img && palette >= 0) {
+        recolor_.apply(img, palette);
+    }
+    return img;
+}
+
+void SpriteCache::insert(const Key &key, const SdlSurface &img)
+{
+    lru_.push_front(key);
+    size_t bytes = img->pitch * img->h;
+    images_.emplace(key, Entry{img, bytes, std::begin(lru_)});
+    used_ += bytes;
+    evict(key);
+}
+
+void SpriteCache::evict(const Key &keep)
+{
+    auto lruIter = std::end(lru_);
+    while (used_ > budget_ && lruIter != std::begin(lru_)) {
+        --lruIter;
+        if (*lruIter == keep) {
+            continue;
+        }
+
+        auto imgIter = images_.find(*lruIter);
+        assert(imgIter != std::end(images_));
+        used_ -= imgIter->second.bytes;
+        images_.erase(imgIter);
+        lruIter = lru_.erase(lruIter);
+    }
+}
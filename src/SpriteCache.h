@@ -0,0 +1,68 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef SPRITE_CACHE_H
+#define SPRITE_CACHE_H
+
+#include "AssetLoader.h"
+#include "sdl_helper.h"
+#include <list>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Load each image from disk once and build team-colored and flipped versions
+// of it on demand.  Once the cache grows past its memory budget, the least
+// recently used images are dropped.  Anything still in use elsewhere stays
+// alive until the caller lets go of it.
+class SpriteCache
+{
+public:
+    SpriteCache(const SdlRecolor &recolor, size_t budgetBytes);
+
+    // Return the image at the given path, recolored with a palette from the
+    // recolor engine (-1 for none) and optionally flipped.  Sprite sheets must
+    // give the number of frames so each one is flipped in place.  Return a
+    // null surface if the image can't be loaded.
+    SdlSurface get(const std::string &path, int palette = -1,
+                   bool flip = false, int numFrames = 1);
+
+    // Decode the base images for several paths at once using a worker pool.
+    // Later calls to get() for these paths only have to recolor and flip.
+    void preload(AssetLoader &loader, const std::vector<std::string> &paths);
+
+    size_t memoryUsed() const;
+    void setBudget(size_t budgetBytes);
+
+private:
+    using Key = std::tuple<std::string, int, int>;  // path, palette, frames
+    using LruList = std::list<Key>;
+    struct Entry
+    {
+        SdlSurface img;
+        size_t bytes;
+        LruList::iterator lruPos;
+    };
+
+    SdlSurface build(const std::string &path, int palette, int flipFrames);
+    void insert(const Key &key, const SdlSurface &img);
+    void evict(const Key &keep);
+
+    const SdlRecolor &recolor_;
+    size_t budget_;
+    size_t used_;
+    std::map<Key, Entry> images_;
+    LruList lru_;  // most recently used first
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace
+{
+    // Copy an image into a page.  Turning off alpha blending on the source
+    // makes SDL copy the alpha channel as-is instead of blending it with the
+    // (empty) page.
+    void copyToPage(const SdlSurface &img, SdlSurface &page, SDL_Rect dest)
+    {
+        auto flags = img->flags & (SDL_SRCALPHA | SDL_RLEACCEL);
+        auto alpha = img->format->alpha;
+        SDL_SetAlpha(img.get(), 0, SDL_ALPHA_OPAQUE);
+        if (SDL_BlitSurface(img.get(), nullptr, page.get(), &dest) < 0) {
+            std::cerr << "Warning: error copying image to atlas: "
+                << SDL_GetError() << '\n';
+        }
+        SDL_SetAlpha(img.get(), flags, alpha);
+    }
+}
+
+TextureAtlas::TextureAtlas(Sint16 pageSize)
+    : pageSize_(pageSize),
+    regions_(),
+    pages_()
+{
+}
+
+int TextureAtlas::add(const SdlSurface &img)
+{
+    Region r;
+    r.img = img;
+    r.rect.x = 0;
+    r.rect.y = 0;
+    r.rect.w = img ? img->w : 0;
+    r.rect.h = img ? img->h : 0;
+    regions_.push_back(r);
+    return regions_.size() - 1;
+}
+
+int TextureAtlas::size() const
+{
+    return regions_.size();
+}
+
+void TextureAtlas::pack()
+{
+    // Gather everything that isn't already on a page.
+    std::vector<int> todo;
+    for (auto i = 0u; i < regions_.size(); ++i) {
+        const auto &r = regions_[i];
+        if (r.img && std::find(std::begin(pages_), std::end(pages_), r.img) ==
+            std::end(pages_))
+        {
+            todo.push_back(i);
+        }
+    }
+
+    // Shelf packing: sort by height, tallest first, and fill rows left to
+    // right.  Map tiles are all the same size so this wastes very little.
+    std::stable_sort(std::begin(todo), std::end(todo), [this] (int a, int b)
+    {
+        return regions_[a].rect.h > regions_[b].rect.h;
+    });
+
+    // Assign positions first so each page can be created at its final size.
+    std::vector<std::vector<int>> pageContents;
+    std::vector<Sint16> pageHeights;
+    Sint16 shelfX = 0;
+    Sint16 shelfY = 0;
+    Sint16 shelfH = 0;
+    for (auto i : todo) {
+        auto &rect = regions_[i].rect;
+        if (rect.w > pageSize_ || rect.h > pageSize_) {
+            // Too big to share, the image is its own page.
+            pages_.push_back(regions_[i].img);
+            continue;
+        }
+
+        if (pageContents.empty() || shelfX + rect.w > pageSize_) {
+            shelfX = 0;
+            shelfY += shelfH;
+            shelfH = rect.h;
+        }
+        if (pageContents.empty() || shelfY + rect.h > pageSize_) {
+            pageContents.emplace_back();
+            pageHeights.push_back(0);
+            shelfX = 0;
+            shelfY = 0;
+            shelfH = rect.h;
+        }
+
+        rect.x = shelfX;
+        rect.y = shelfY;
+        shelfX += rect.w;
+        pageContents.back().push_back(i);
+        pageHeights.back() = shelfY + shelfH;
+    }
+
+    for (auto p = 0u; p < pageContents.size(); ++p) {
+        auto page = sdlCreateSurface(pageSize_, pageHeights[p]);
+        if (page) {
+            page = sdlDisplayFormat(page);
+        }
+        if (!page) {
+            // Leave these images where they were.
+            for (auto i : pageContents[p]) {
+                regions_[i].rect.x = 0;
+                regions_[i].rect.y = 0;
+            }
+            continue;
+        }
+
+        SDL_FillRect(page.get(), nullptr, 0);
+        for (auto i : pageContents[p]) {
+            auto &r = regions_[i];
+            copyToPage(r.img, page, r.rect);
+            r.img = page;
+        }
+        pages_.push_back(page);
+    }
+}
+
+int TextureAtlas::numPages() const
+{
+    return pages_.size();
+}
+
+Sint16 TextureAtlas::width(int id) const
+{
+    assert(id >= 0 && id < size());
+    return regions_[id].rect.w;
+}
+
+Sint16 TextureAtlas::height(int id) const
+{
+    assert(id >= 0 && id < size());
+    return regions_[id].rect.h;
+}
+
+void TextureAtlas::draw(int id, Sint16 px, Sint16 py) const
+{
+    assert(id >= 0 && id < size());
+    const auto &r = regions_[id];
+    if (r.img) {
+        sdlBlit(r.img, r.rect, px, py);
+    }
+}
+
+void TextureAtlas::draw(int id, const Point &pos) const
+{
+    draw(id, pos.first, pos.second);
+}
+
+void TextureAtlas::drawFrame(int id, int frame, int numFrames, Sint16 px,
+                             Sint16 py) const
+{
+    assert(id >= 0 && id < size());
+    const auto &r = regions_[id];
+    if (r.img) {
+        sdlBlitFrame(r.img, r.rect, frame, numFrames, px, py);
+    }
+}
+
+void TextureAtlas::drawFrame(int id, int frame, int numFrames,
+                             const Point &pos) const
+{
+    drawFrame(id, frame, numFrames, pos.first, pos.second);
+}
+
+void TextureAtlas::draw(DrawList &list, int id, Sint16 px, Sint16 py,
+                        Uint16 z) const
+{
+    assert(id >= 0 && id < size());
+    const auto &r = regions_[id];
+    list.add(r.img, r.rect, px, py, z);
+}
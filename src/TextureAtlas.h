@@ -0,0 +1,66 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "DrawList.h"
+#include "sdl_helper.h"
+#include <vector>
+
+// Pack many small images into a few large surfaces so that drawing a screen
+// full of them reads from the same block of memory instead of dozens of
+// scattered ones.  Add every image first, then pack() them.  Images are
+// referred to by the id returned from add().
+class TextureAtlas
+{
+public:
+    explicit TextureAtlas(Sint16 pageSize = 1024);
+
+    // Add an image to be packed.  All images must be in the display format.
+    // A null image is allowed (it draws nothing) so load failures don't
+    // shift the ids of everything after them.
+    int add(const SdlSurface &img);
+    int size() const;
+
+    // Copy all images added so far into atlas pages and release the
+    // originals.  Images too big for a page get a page of their own.  Main
+    // thread only.
+    void pack();
+    int numPages() const;
+
+    Sint16 width(int id) const;
+    Sint16 height(int id) const;
+
+    // Draw an image, or one frame of a sprite sheet, with (px,py) as the
+    // upper-left corner.  Images can be drawn before pack() too.
+    void draw(int id, Sint16 px, Sint16 py) const;
+    void draw(int id, const Point &pos) const;
+    void drawFrame(int id, int frame, int numFrames, Sint16 px, Sint16 py) const;
+    void drawFrame(int id, int frame, int numFrames, const Point &pos) const;
+
+    // Add an image to a draw list instead of drawing it right away.
+    void draw(DrawList &list, int id, Sint16 px, Sint16 py, Uint16 z) const;
+
+private:
+    struct Region
+    {
+        SdlSurface img;  // atlas page, or the original image before packing
+        SDL_Rect rect;
+    };
+
+    Sint16 pageSize_;
+    std::vector<Region> regions_;
+    std::vector<SdlSurface> pages_;
+};
+
+#endif
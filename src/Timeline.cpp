@@ -0,0 +1,341 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "Timeline.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    template <typename T>
+    void sortByTime(std::vector<T> &keys)
+    {
+        std::stable_sort(std::begin(keys), std::end(keys),
+                         [] (const T &lhs, const T &rhs) {
+                             return lhs.time_ms < rhs.time_ms;
+                         });
+    }
+}
+
+Timeline::Timeline(SpriteCache &cache)
+    : cache_(cache),
+    clips_(),
+    soundFiles_(),
+    units_(),
+    active_(),
+    pending_(),
+    seq_(0),
+    sounds_(),
+    sheets_()
+{
+}
+
+bool Timeline::load(const char *filename)
+{
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "Error loading animations " << filename << '\n';
+        return false;
+    }
+
+    std::vector<Clip> clips;
+    std::vector<std::string> soundFiles;
+    std::string line;
+    int lineNum = 0;
+    while (std::getline(in, line)) {
+        ++lineNum;
+        std::istringstream str(line);
+        std::string type;
+        str >> type;
+        if (type.empty() || type[0] == '#') {
+            continue;
+        }
+
+        Uint32 time_ms = 0;
+        bool ok = true;
+        if (type == "clip") {
+            Clip c;
+            str >> c.name >> c.duration_ms >> c.layer >> c.image >>
+                c.numFrames;
+            ok = str && c.layer >= 0 && c.numFrames > 0;
+            clips.push_back(std::move(c));
+        }
+        else if (clips.empty()) {
+            ok = false;
+        }
+        else if (type == "frame") {
+            int frame = 0;
+            str >> time_ms >> frame;
+            ok = str && frame >= -1 && frame < clips.back().numFrames;
+            clips.back().frames.push_back(FrameKey{time_ms, frame});
+        }
+        else if (type == "move") {
+            double fraction = 0.0;
+            str >> time_ms >> fraction;
+            ok = bool(str);
+            clips.back().moves.push_back(MoveKey{time_ms, fraction});
+        }
+        else if (type == "sound") {
+            std::string file;
+            str >> time_ms >> file;
+            ok = bool(str);
+            auto iter = std::find(std::begin(soundFiles), std::end(soundFiles),
+                                  file);
+            int id = iter - std::begin(soundFiles);
+            if (iter == std::end(soundFiles)) {
+                soundFiles.push_back(file);
+            }
+            clips.back().sounds.push_back(SoundKey{time_ms, id});
+        }
+        else {
+            ok = false;
+        }
+
+        if (ok && type != "clip" && time_ms > clips.back().duration_ms) {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Error in " << filename << " line " << lineNum <<
+                ": " << line << '\n';
+            return false;
+        }
+    }
+
+    for (auto &c : clips) {
+        sortByTime(c.frames);
+        sortByTime(c.moves);
+        sortByTime(c.sounds);
+    }
+    clips_ = std::move(clips);
+    soundFiles_ = std::move(soundFiles);
+    sheets_.clear();
+    return true;
+}
+
+int Timeline::clip(const std::string &name) const
+{
+    for (unsigned i = 0; i < clips_.size(); ++i) {
+        if (clips_[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+std::vector<std::string> Timeline::imageFiles() const
+{
+    std::vector<std::string> files;
+    for (const auto &c : clips_) {
+        if (std::find(std::begin(files), std::end(files), c.image) ==
+            std::end(files))
+        {
+            files.push_back(c.image);
+        }
+    }
+    return files;
+}
+
+const std::vector<std::string> & Timeline::soundFiles() const
+{
+    return soundFiles_;
+}
+
+int Timeline::addUnit(const SdlSurface &base, const Point &pos, int palette,
+                      bool mirrored)
+{
+    Unit u;
+    u.base = base;
+    u.pos = pos;
+    u.target = pos;
+    u.palette = palette;
+    u.mirrored = mirrored;
+    u.clip = -1;
+    u.start_ms = 0;
+    u.frameKey = 0;
+    u.moveKey = 0;
+    u.soundKey = 0;
+    u.prevPos = pos;
+    u.drawPos = pos;
+    u.drawFrame = -1;
+    units_.push_back(u);
+    return units_.size() - 1;
+}
+
+void Timeline::play(int unit, int clipId, Uint32 now_ms, Uint32 delay_ms,
+                    const Point &target)
+{
+    if (unit < 0 || unit >= static_cast<int>(units_.size()) ||
+        clipId < 0 || clipId >= static_cast<int>(clips_.size()))
+    {
+        std::cerr << "Error playing animation: invalid unit or clip\n";
+        return;
+    }
+
+    auto t = (target == hInvalid) ? units_[unit].pos : target;
+    pending_.push(Pending{now_ms + delay_ms, seq_++, unit, clipId, t});
+}
+
+void Timeline::update(Uint32 now_ms)
+{
+    while (!pending_.empty() && pending_.top().start_ms <= now_ms) {
+        start(pending_.top());
+        pending_.pop();
+    }
+
+    // Units are dropped from the active list when their clip ends.  Order
+    // doesn't matter here, draw() sorts by layer.
+    unsigned i = 0;
+    while (i < active_.size()) {
+        auto &u = units_[active_[i]];
+        advance(u, now_ms);
+        if (u.clip == -1) {
+            active_[i] = active_.back();
+            active_.pop_back();
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+bool Timeline::pollSound(int &soundId)
+{
+    if (sounds_.empty()) {
+        return false;
+    }
+    soundId = sounds_.front();
+    sounds_.pop();
+    return true;
+}
+
+bool Timeline::busy() const
+{
+    return !active_.empty() || !pending_.empty();
+}
+
+void Timeline::draw(DrawList &list, Uint16 z, double alpha)
+{
+    for (auto &u : units_) {
+        auto delta = u.drawPos - u.prevPos;
+        Sint16 px = u.prevPos.first + alpha * delta.first;
+        Sint16 py = u.prevPos.second + alpha * delta.second;
+        Uint16 unitZ = z + (u.clip >= 0 ? clips_[u.clip].layer : 0);
+
+        if (u.drawFrame == -1) {
+            list.addFrame(u.base, 0, 1, px, py, unitZ, u.mirrored);
+        }
+        else {
+            list.addFrame(sheet(u), u.drawFrame, clips_[u.clip].numFrames,
+                          px, py, unitZ, u.mirrored);
+        }
+    }
+}
+
+bool Timeline::LaterStart::operator()(const Pending &lhs,
+                                      const Pending &rhs) const
+{
+    if (lhs.start_ms != rhs.start_ms) {
+        return lhs.start_ms > rhs.start_ms;
+    }
+    return lhs.seq > rhs.seq;
+}
+
+void Timeline::start(const Pending &p)
+{
+    auto &u = units_[p.unit];
+    if (u.clip == -1) {
+        active_.push_back(p.unit);
+    }
+    u.target = p.target;
+    u.clip = p.clip;
+    u.start_ms = p.start_ms;
+    u.frameKey = 0;
+    u.moveKey = 0;
+    u.soundKey = 0;
+}
+
+void Timeline::advance(Unit &u, Uint32 now_ms)
+{
+    const auto &c = clips_[u.clip];
+    auto elapsed_ms = std::min(now_ms - u.start_ms, c.duration_ms);
+    u.prevPos = u.drawPos;
+
+    // Each cursor only moves forward, so over the life of a clip every
+    // keyframe is visited once.
+    while (u.soundKey < c.sounds.size() &&
+           c.sounds[u.soundKey].time_ms <= elapsed_ms)
+    {
+        sounds_.push(c.sounds[u.soundKey].sound);
+        ++u.soundKey;
+    }
+
+    if (elapsed_ms >= c.duration_ms) {
+        u.clip = -1;
+        u.prevPos = u.pos;
+        u.drawPos = u.pos;
+        u.drawFrame = -1;
+        return;
+    }
+
+    const auto &frames = c.frames;
+    while (u.frameKey + 1 < frames.size() &&
+           frames[u.frameKey + 1].time_ms <= elapsed_ms)
+    {
+        ++u.frameKey;
+    }
+    if (frames.empty() || frames[u.frameKey].time_ms > elapsed_ms) {
+        u.drawFrame = -1;
+    }
+    else {
+        u.drawFrame = frames[u.frameKey].frame;
+    }
+
+    const auto &moves = c.moves;
+    while (u.moveKey + 1 < moves.size() &&
+           moves[u.moveKey + 1].time_ms <= elapsed_ms)
+    {
+        ++u.moveKey;
+    }
+    double fraction = 0.0;
+    if (!moves.empty()) {
+        const auto &k1 = moves[u.moveKey];
+        fraction = k1.fraction;
+        if (u.moveKey + 1 < moves.size() && k1.time_ms <= elapsed_ms) {
+            const auto &k2 = moves[u.moveKey + 1];
+            fraction += (k2.fraction - k1.fraction) *
+                (elapsed_ms - k1.time_ms) / (k2.time_ms - k1.time_ms);
+        }
+    }
+    auto delta = u.target - u.pos;
+    u.drawPos.first = u.pos.first + fraction * delta.first;
+    u.drawPos.second = u.pos.second + fraction * delta.second;
+}
+
+const SdlSurface & Timeline::sheet(const Unit &u)
+{
+    unsigned row = u.palette + 1;
+    if (row >= sheets_.size()) {
+        sheets_.resize(row + 1);
+    }
+    auto &sheetsForPalette = sheets_[row];
+    if (sheetsForPalette.size() < clips_.size()) {
+        sheetsForPalette.resize(clips_.size());
+    }
+
+    auto &img = sheetsForPalette[u.clip];
+    if (!img) {
+        img = cache_.get(clips_[u.clip].image, u.palette);
+    }
+    return img;
+}
@@ -0,0 +1,161 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "DrawList.h"
+#include "SpriteCache.h"
+#include "hex_utils.h"
+#include "sdl_helper.h"
+#include <queue>
+#include <string>
+#include <vector>
+
+// Play animation clips on any number of units.  A clip is a sprite sheet plus
+// three tracks of keyframes, each sorted by time:
+// - frame: which frame of the sheet to show from this point on (-1 for the
+//   unit's base image)
+// - move: fraction of the way toward the unit's target, interpolated linearly
+//   between keyframes
+// - sound: a sound to play at this point
+//
+// Clips are loaded from a text file, one keyframe per line:
+//     clip <name> <duration ms> <layer> <sprite sheet> <number of frames>
+//     frame <ms> <frame index>
+//     move <ms> <fraction>
+//     sound <ms> <sound file>
+// Keyframes belong to the most recent clip.  Blank lines and lines starting
+// with '#' are ignored.  Units on higher layers are drawn on top.
+//
+// Each unit remembers where it is in every track, so finding the current
+// keyframe is amortized O(1) per update no matter how long the clip is.
+// Timelines are driven by the caller's clock, not SDL_GetTicks(), so they
+// play back the same under load when run from a fixed-step loop.
+class Timeline
+{
+public:
+    explicit Timeline(SpriteCache &cache);
+
+    // Return false if the file can't be read or has errors.
+    bool load(const char *filename);
+
+    // Return the id of the named clip, or -1 if there isn't one.
+    int clip(const std::string &name) const;
+
+    // Every file referenced by the loaded clips, for preloading.  Sound ids
+    // returned from pollSound() are indexes into soundFiles().
+    std::vector<std::string> imageFiles() const;
+    const std::vector<std::string> & soundFiles() const;
+
+    // Add a unit standing at the given pixel position, drawn with 'base'
+    // when it isn't animating.  A null base means the unit is only visible
+    // while animating.  Clip sprite sheets are recolored with 'palette'.
+    // Return the unit id.
+    int addUnit(const SdlSurface &base, const Point &pos, int palette = -1,
+                bool mirrored = false);
+
+    // Start a clip on a unit 'delay_ms' after 'now_ms'.  Move keyframes are
+    // relative to the target position.  A clip replaces whatever the unit was
+    // doing when it starts.
+    void play(int unit, int clipId, Uint32 now_ms, Uint32 delay_ms = 0,
+              const Point &target = hInvalid);
+
+    // Advance every unit to the given time.
+    void update(Uint32 now_ms);
+
+    // Pop the next sound that came due during update().  Return false if
+    // there aren't any.
+    bool pollSound(int &soundId);
+
+    // True if any unit is animating or has a clip waiting to start.
+    bool busy() const;
+
+    // Add every unit to a draw list, at z plus the layer of its clip.
+    // Moving units are drawn 'alpha' of the way from where they were at the
+    // previous update to where they are now, for use with SdlFixedStep.
+    void draw(DrawList &list, Uint16 z, double alpha = 1.0);
+
+private:
+    struct FrameKey
+    {
+        Uint32 time_ms;
+        int frame;
+    };
+    struct MoveKey
+    {
+        Uint32 time_ms;
+        double fraction;
+    };
+    struct SoundKey
+    {
+        Uint32 time_ms;
+        int sound;
+    };
+    struct Clip
+    {
+        std::string name;
+        Uint32 duration_ms;
+        int layer;
+        std::string image;
+        int numFrames;
+        std::vector<FrameKey> frames;
+        std::vector<MoveKey> moves;
+        std::vector<SoundKey> sounds;
+    };
+    struct Unit
+    {
+        SdlSurface base;
+        Point pos;
+        Point target;
+        int palette;
+        bool mirrored;
+        int clip;  // -1 when not animating
+        Uint32 start_ms;
+        unsigned frameKey;  // cursors into the clip's tracks
+        unsigned moveKey;
+        unsigned soundKey;
+        Point prevPos;  // drawPos as of the previous update
+        Point drawPos;
+        int drawFrame;
+    };
+    struct Pending
+    {
+        Uint32 start_ms;
+        unsigned seq;  // keeps clips starting at the same time in order
+        int unit;
+        int clip;
+        Point target;
+    };
+    struct LaterStart
+    {
+        bool operator()(const Pending &lhs, const Pending &rhs) const;
+    };
+
+    void start(const Pending &p);
+    void advance(Unit &u, Uint32 now_ms);
+    const SdlSurface & sheet(const Unit &u);
+
+    SpriteCache &cache_;
+    std::vector<Clip> clips_;
+    std::vector<std::string> soundFiles_;
+    std::vector<Unit> units_;
+    std::vector<int> active_;  // units currently animating
+    std::priority_queue<Pending, std::vector<Pending>, LaterStart> pending_;
+    unsigned seq_;
+    std::queue<int> sounds_;
+
+    // Recolored sprite sheets, indexed by [palette + 1][clip].
+    std::vector<std::vector<SdlSurface>> sheets_;
+};
+
+#endif
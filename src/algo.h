@@ -14,6 +14,8 @@
 #define ALGO_H
 
 #include <algorithm>
+#include <chrono>
+#include <future>
 #include <memory>
 #include <random>
 
@@ -37,6 +39,15 @@ std::unique_ptr<T> make_unique(Args &&... args)
     return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
 }
 
+// Return true if a background task has finished without blocking to wait for
+// it.  Returns false if the result has already been retrieved.
+template <class T>
+bool isReady(const std::future<T> &f)
+{
+    return f.valid() &&
+        f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
 std::minstd_rand & randomGenerator();
 
 #endif
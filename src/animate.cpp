@@ -10,15 +10,15 @@
  
     See the COPYING.txt file for more details.
 */
+#include "AssetLoader.h"
+#include "SpriteCache.h"
+#include "Timeline.h"
 #include "hex_utils.h"
 #include "sdl_helper.h"
+#include <future>
 #include <iostream>
-#include <unordered_map>
 #include <vector>
 
-// Who is animating right now?
-enum class Animating { NONE, BOWMAN, MARSHAL, GRUNT };
-
 namespace
 {
     const Sint16 width = 5;
@@ -28,72 +28,13 @@ namespace
     SDL_Rect window = {0, 0, pWidth, pHeight};
 
     SdlSurface tile;
-    SdlSurface bowman;
-    SdlSurface bowmanAttack;
-    SdlSurface marshal;
-    SdlSurface marshalAttack;
-    SdlSurface marshalDefend;
-    SdlSurface missile;
-    SdlSurface archer;
-    SdlSurface archerDefend;
-    SdlSurface grunt;
-    SdlSurface gruntDefend;
-    SdlSurface gruntAttack;
-
-    Uint32 animStart_ms = 0;
-    auto subject = Animating::NONE;
-
-    bool bowSoundPlayed = false;
-    bool archerHitSoundPlayed = false;
-    bool swordSoundPlayed = false;
-    bool gruntHitSoundPlayed = false;
-    bool retaliateSoundPlayed = false;
-    bool marshalHitSoundPlayed = false;
-
-    std::vector<Uint32> redColors;
-    std::vector<Uint32> blueColors;
-    std::unordered_map<Uint32, int> baseColors;
-}
-
-// source: Battle for Wesnoth, recolor_image() in sdl_utils.cpp.
-void applyTeamColor(SdlSurface &img, int team)
-{
-    std::vector<Uint32> *teamColors = &blueColors;
-    if (team == 1) {
-        teamColors = &redColors;
-    }
-
-    SdlLock(img, [&] {
-        auto pixel = static_cast<Uint32 *>(img->pixels);
-        auto end = pixel + img->w * img->h;
-        for (; pixel != end; ++pixel) {
-            Uint32 alpha = (*pixel) & 0xFF000000;
-            if (alpha == 0) continue;  // skip invisible pixels
-
-            // Base team colors are RGB only, mask off alpha channel.
-            Uint32 curColor = (*pixel) & 0x00FFFFFF;
-            const auto &colorKey = baseColors.find(curColor);
-            if (colorKey != std::end(baseColors)) {
-                *pixel = alpha + (*teamColors)[colorKey->second];
-            }
-        }
-    });
-}
 
-void loadImages()
-{
-    tile = sdlLoadImage("../img/hex-grid.png");
-    bowman = sdlLoadImage("../img/bowman.png");
-    bowmanAttack = sdlLoadImage("../img/bowman-attack-ranged.png");
-    marshal = sdlLoadImage("../img/marshal.png");
-    marshalAttack = sdlLoadImage("../img/marshal-attack-melee.png");
-    marshalDefend = sdlLoadImage("../img/marshal-defend.png");
-    missile = sdlLoadImage("../img/missile.png");
-    archer = sdlFlipH(sdlLoadImage("../img/orc-archer.png"));
-    archerDefend = sdlFlipH(sdlLoadImage("../img/orc-archer-defend.png"));
-    grunt = sdlFlipH(sdlLoadImage("../img/orc-grunt.png"));
-    gruntDefend = sdlFlipH(sdlLoadImage("../img/orc-grunt-defend.png"));
-    gruntAttack = sdlFlipSheetH(sdlLoadImage("../img/orc-grunt-attack-melee.png"), 7);
+    // Timeline unit ids.
+    int bowman = -1;
+    int missile = -1;
+    int marshal = -1;
+    int archer = -1;
+    int grunt = -1;
 }
 
 // Generate the 19 different shades that will be used to re-color sprites
@@ -138,27 +79,27 @@ std::vector<Uint32> setTeamColors(Uint8 red, Uint8 green, Uint8 blue)
 
 // These are the colors otherwise unused by unit graphics.  They will be
 // replaced by corresponding team colors.
-void setBaseColors()
+std::vector<Uint32> getBaseColors()
 {
-    baseColors.emplace(SDL_MapRGB(screen->format, 0x3F, 0, 0x16), 0);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0x55, 0, 0x2A), 1);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0x69, 0, 0x39), 2);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0x7B, 0, 0x45), 3);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0x8C, 0, 0x51), 4);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0x9E, 0, 0x5D), 5);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xB1, 0, 0x69), 6);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xC3, 0, 0x74), 7);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xD6, 0, 0x7F), 8);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xEC, 0, 0x8C), 9);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xEE, 0x3D, 0x96), 10);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xEF, 0x5B, 0xA1), 11);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xF1, 0x72, 0xAC), 12);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xF2, 0x87, 0xB6), 13);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xF4, 0x9A, 0xC1), 14);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xF6, 0xAD, 0xCD), 15);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xF8, 0xC1, 0xD9), 16);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xFA, 0xD5, 0xE5), 17);
-    baseColors.emplace(SDL_MapRGB(screen->format, 0xFD, 0xE9, 0xF1), 18);
+    return {SDL_MapRGB(screen->format, 0x3F, 0, 0x16),
+            SDL_MapRGB(screen->format, 0x55, 0, 0x2A),
+            SDL_MapRGB(screen->format, 0x69, 0, 0x39),
+            SDL_MapRGB(screen->format, 0x7B, 0, 0x45),
+            SDL_MapRGB(screen->format, 0x8C, 0, 0x51),
+            SDL_MapRGB(screen->format, 0x9E, 0, 0x5D),
+            SDL_MapRGB(screen->format, 0xB1, 0, 0x69),
+            SDL_MapRGB(screen->format, 0xC3, 0, 0x74),
+            SDL_MapRGB(screen->format, 0xD6, 0, 0x7F),
+            SDL_MapRGB(screen->format, 0xEC, 0, 0x8C),
+            SDL_MapRGB(screen->format, 0xEE, 0x3D, 0x96),
+            SDL_MapRGB(screen->format, 0xEF, 0x5B, 0xA1),
+            SDL_MapRGB(screen->format, 0xF1, 0x72, 0xAC),
+            SDL_MapRGB(screen->format, 0xF2, 0x87, 0xB6),
+            SDL_MapRGB(screen->format, 0xF4, 0x9A, 0xC1),
+            SDL_MapRGB(screen->format, 0xF6, 0xAD, 0xCD),
+            SDL_MapRGB(screen->format, 0xF8, 0xC1, 0xD9),
+            SDL_MapRGB(screen->format, 0xFA, 0xD5, 0xE5),
+            SDL_MapRGB(screen->format, 0xFD, 0xE9, 0xF1)};
 }
 
 Point pixelFromHex(Sint16 hx, Sint16 hy)
@@ -168,245 +109,45 @@ Point pixelFromHex(Sint16 hx, Sint16 hy)
     return {px, py};
 }
 
-// attack animation lasts 600 ms
-// first half, slide toward hex 2,3 (get halfway there)
-// second half, slide back
-Point slideToTarget(const Point &src, const Point &target, Uint32 elapsed_ms)
-{
-    auto delta = (target - src) / 2;
-    Sint16 drawX = 0;
-    Sint16 drawY = 0;
-    if (elapsed_ms < 300) {
-        drawX = elapsed_ms / 300.0 * delta.first + src.first;
-        drawY = elapsed_ms / 300.0 * delta.second + src.second;
-    }
-    else {
-        drawX = (600 - elapsed_ms) / 300.0 * delta.first + src.first;
-        drawY = (600 - elapsed_ms) / 300.0 * delta.second + src.second;
-    }
-
-    return {drawX, drawY};
-}
-
-void handleMouseUp(const SDL_MouseButtonEvent &event)
+// Left click for a ranged attack, right click for a melee attack followed by
+// a retaliation.  Clicks are ignored while animating.
+void handleMouseUp(const SDL_MouseButtonEvent &event, Timeline &timeline,
+                   Uint32 now_ms)
 {
-    // Ignore mouse clicks while animating.
-    if (subject != Animating::NONE) {
+    if (timeline.busy()) {
         return;
     }
 
     if (event.button == SDL_BUTTON_LEFT) {
-        subject = Animating::BOWMAN;
-        animStart_ms = SDL_GetTicks();
-        bowSoundPlayed = false;
-        archerHitSoundPlayed = false;
+        // The arrow leaves as the shooter animation releases it and hits
+        // after it's flown three hexes.
+        timeline.play(bowman, timeline.clip("bowman-attack"), now_ms);
+        timeline.play(missile, timeline.clip("arrow"), now_ms, 295,
+                      pixelFromHex(4, 2));
+        timeline.play(archer, timeline.clip("archer-defend"), now_ms, 745);
     }
     else if (event.button == SDL_BUTTON_RIGHT) {
-        subject = Animating::MARSHAL;
-        animStart_ms = SDL_GetTicks();
-        swordSoundPlayed = false;
-        gruntHitSoundPlayed = false;
-        retaliateSoundPlayed = false;
-        marshalHitSoundPlayed = false;
+        timeline.play(marshal, timeline.clip("marshal-attack"), now_ms, 0,
+                      pixelFromHex(2, 3));
+        timeline.play(grunt, timeline.clip("grunt-defend"), now_ms, 300);
+        timeline.play(grunt, timeline.clip("grunt-attack"), now_ms, 900,
+                      pixelFromHex(1, 2));
+        timeline.play(marshal, timeline.clip("marshal-defend"), now_ms, 1200);
     }
 }
 
 // Draw a 5-hex wide hexagonal grid.
-void drawHexGrid()
+void drawHexGrid(DrawList &list)
 {
     for (int x = 0; x < 5; ++x) {
         for (int y = 1; y < 4; ++y) {
-            sdlBlit(tile, pixelFromHex(x, y));
+            list.add(tile, pixelFromHex(x, y), 0);
         }
     }
-    sdlBlit(tile, pixelFromHex(1, 0));
-    sdlBlit(tile, pixelFromHex(2, 0));
-    sdlBlit(tile, pixelFromHex(3, 0));
-    sdlBlit(tile, pixelFromHex(2, 4));
-}
-
-void drawBowman(const SdlSound &bowSound)
-{
-    auto hex = pixelFromHex(1, 0);
-    if (subject != Animating::BOWMAN) {
-        sdlBlit(bowman, hex);
-        return;
-    }
-
-    Uint32 frameSeq_ms[] = {65, 140, 215, 315, 445, 510};
-    auto elapsed_ms = SDL_GetTicks() - animStart_ms;
-    if (elapsed_ms > 510) {
-        sdlBlit(bowman, hex);
-        return;
-    }
-
-    for (int i = 0; i < 6; ++i) {
-        if (elapsed_ms < frameSeq_ms[i]) {
-            sdlBlitFrame(bowmanAttack, i, 6, hex);
-            break;
-        }
-    }
-
-    if (!bowSoundPlayed && elapsed_ms > 140) {
-        sdlPlaySound(bowSound);
-        bowSoundPlayed = true;
-    }
-}
-
-void drawMissile()
-{
-    if (subject != Animating::BOWMAN) {
-        return;
-    }
-
-    auto elapsed_ms = SDL_GetTicks() - animStart_ms;
-    if (elapsed_ms < 295 || elapsed_ms > 745) {
-        return;
-    }
-
-    auto start = pixelFromHex(1, 0);
-    auto delta = pixelFromHex(4, 2) - start;
-
-    // Arrow flies 1 hex in 150 ms.  Total distance is 3 hexes, so time of
-    // flight is 450 ms.
-    auto dt = (elapsed_ms - 295) / 450.0;
-    Sint16 px = start.first + dt * delta.first;
-    Sint16 py = start.second + dt * delta.second;
-
-    // If we did this for real, we'd have to compute angle.  In this case we
-    // know arrow flies southeast.
-    auto direction = static_cast<int>(Dir::SE);
-    sdlBlitFrame(missile, direction, 6, px, py);
-}
-
-void drawMarshal(const SdlSound &swordSound, const SdlSound &hitSound)
-{
-    auto hex = pixelFromHex(1, 2);
-    auto elapsed_ms = SDL_GetTicks() - animStart_ms;
-
-    if (subject == Animating::MARSHAL) {
-        Uint32 frameSeq_ms[] = {50, 100, 200, 275, 375, 425, 500};
-        if (elapsed_ms > 600 && elapsed_ms <= 900) {
-            sdlBlit(marshal, hex);
-            return;
-        }
-        else if (elapsed_ms > 900) {
-            // Start a retaliation after the attack finishes.
-            subject = Animating::GRUNT;
-            animStart_ms = SDL_GetTicks();
-            return;
-        }
-
-        auto drawPos = slideToTarget(hex, pixelFromHex(2, 3), elapsed_ms);
-
-        // Past the end of the animated frames, draw the base image.
-        if (elapsed_ms > 500) {
-            sdlBlit(marshal, drawPos);
-            return;
-        }
-
-        for (int i = 0; i < 7; ++i) {
-            if (elapsed_ms < frameSeq_ms[i]) {
-                sdlBlitFrame(marshalAttack, i, 7, drawPos);
-                break;
-            }
-        }
-
-        if (!swordSoundPlayed && elapsed_ms > 100) {
-            sdlPlaySound(swordSound);
-            swordSoundPlayed = true;
-        }
-    }
-    else if (subject == Animating::GRUNT) {
-        if (elapsed_ms >= 300 && elapsed_ms < 550) {
-            sdlBlit(marshalDefend, hex);
-            if (!marshalHitSoundPlayed) {
-                sdlPlaySound(hitSound);
-                marshalHitSoundPlayed = true;
-            }
-        }
-        else {
-            sdlBlit(marshal, hex);
-        }
-    }
-    else {
-        sdlBlit(marshal, hex);
-    }
-}
-
-void drawEnemy1(const SdlSound &hitSound)
-{
-    auto hex = pixelFromHex(4, 2);
-    if (subject != Animating::BOWMAN) {
-        sdlBlit(archer, hex);
-        return;
-    }
-
-    auto elapsed_ms = SDL_GetTicks() - animStart_ms;
-    if (elapsed_ms < 745) {  // shooter animation plus time of flight
-        sdlBlit(archer, hex);
-    }
-    else if (elapsed_ms < 995) {
-        sdlBlit(archerDefend, hex);
-        if (!archerHitSoundPlayed) {
-            sdlPlaySound(hitSound);
-            archerHitSoundPlayed = true;
-        }
-    }
-    else {
-        sdlBlit(archer, hex);
-        subject = Animating::NONE;
-    }
-}
-
-void drawEnemy2(const SdlSound &swordSound, const SdlSound &hitSound)
-{
-    auto hex = pixelFromHex(2, 3);
-    auto elapsed_ms = SDL_GetTicks() - animStart_ms;
-
-    if (subject == Animating::GRUNT) {
-        Uint32 frameSeq_ms[] = {50, 100, 200, 275, 375, 425, 500};
-        if (elapsed_ms > 600) {
-            sdlBlit(grunt, hex);
-            subject = Animating::NONE;
-            return;
-        }
-
-        auto drawPos = slideToTarget(hex, pixelFromHex(1, 2), elapsed_ms);
-
-        // Past the end of the animated frames, draw the base image.
-        if (elapsed_ms > 500) {
-            sdlBlit(grunt, drawPos);
-            return;
-        }
-
-        for (int i = 0; i < 7; ++i) {
-            if (elapsed_ms < frameSeq_ms[i]) {
-                sdlBlitFrame(gruntAttack, i, 7, drawPos);
-                break;
-            }
-        }
-
-        if (!retaliateSoundPlayed && elapsed_ms > 100) {
-            sdlPlaySound(swordSound);
-            retaliateSoundPlayed = true;
-        }
-    }
-    else if (subject == Animating::MARSHAL) {
-        if (elapsed_ms >= 300 && elapsed_ms < 550) {
-            sdlBlit(gruntDefend, hex);
-            if (!gruntHitSoundPlayed) {
-                sdlPlaySound(hitSound);
-                gruntHitSoundPlayed = true;
-            }
-        }
-        else {
-            sdlBlit(grunt, hex);
-        }
-    }
-    else {
-        sdlBlit(grunt, hex);
-    }
+    list.add(tile, pixelFromHex(1, 0), 0);
+    list.add(tile, pixelFromHex(2, 0), 0);
+    list.add(tile, pixelFromHex(3, 0), 0);
+    list.add(tile, pixelFromHex(2, 4), 0);
 }
 
 extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
@@ -414,72 +155,99 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
     if (!sdlInit(window.w, window.h, "../img/icon.png", "Animation Test")) {
         return EXIT_FAILURE;
     }
+    sdlLoadBundle("../assets.bundle");  // optional, see mkbundle.cpp
 
-    loadImages();
-    setBaseColors();
-    redColors = setTeamColors(0xFF, 0, 0);
-    blueColors = setTeamColors(0x2E, 0x41, 0x9B);
+    SdlRecolor teamColors(getBaseColors(), screen->format);
+    auto blue = teamColors.addPalette(setTeamColors(0x2E, 0x41, 0x9B));
+    auto red = teamColors.addPalette(setTeamColors(0xFF, 0, 0));
 
-    applyTeamColor(bowman, 0);
-    applyTeamColor(bowmanAttack, 0);
-    applyTeamColor(marshal, 0);
-    applyTeamColor(marshalAttack, 0);
-    applyTeamColor(marshalDefend, 0);
-    applyTeamColor(archer, 1);
-    applyTeamColor(archerDefend, 1);
-    applyTeamColor(grunt, 1);
-    applyTeamColor(gruntDefend, 1);
-    applyTeamColor(gruntAttack, 1);
+    AssetLoader loader;
+    SpriteCache cache(teamColors, 8 * 1024 * 1024);
+    Timeline timeline(cache);
+    if (!timeline.load("../animations.txt")) {
+        return EXIT_FAILURE;
+    }
 
-    // Load sounds (can't do this at file scope).
-    auto bowFired = sdlLoadSound("../sounds/bow.ogg");
-    auto marshalHit = sdlLoadSound("../sounds/human-hit.ogg");
-    auto archerHit = sdlLoadSound("../sounds/orc-small-hit.ogg");
-    auto gruntHit = sdlLoadSound("../sounds/orc-hit.ogg");
-    auto swordSwing = sdlLoadSound("../sounds/sword.ogg");
+    // Load sounds (can't do this at file scope).  They decode in the
+    // background while the sprites load.
+    std::vector<std::future<SdlSound>> futureSounds;
+    for (const auto &file : timeline.soundFiles()) {
+        futureSounds.push_back(loader.loadSound(file));
+    }
+
+    auto images = timeline.imageFiles();
+    images.insert(std::end(images), {"../img/hex-grid.png",
+                                     "../img/bowman.png",
+                                     "../img/marshal.png",
+                                     "../img/orc-archer.png",
+                                     "../img/orc-grunt.png"});
+    cache.preload(loader, images);
+
+    // All sprites face right.  The enemies are mirrored as they're drawn.
+    tile = cache.get("../img/hex-grid.png");
+    bowman = timeline.addUnit(cache.get("../img/bowman.png", blue),
+                              pixelFromHex(1, 0), blue);
+    missile = timeline.addUnit(nullptr, pixelFromHex(1, 0));
+    marshal = timeline.addUnit(cache.get("../img/marshal.png", blue),
+                               pixelFromHex(1, 2), blue);
+    archer = timeline.addUnit(cache.get("../img/orc-archer.png", red),
+                              pixelFromHex(4, 2), red, true);
+    grunt = timeline.addUnit(cache.get("../img/orc-grunt.png", red),
+                             pixelFromHex(2, 3), red, true);
+
+    std::vector<SdlSound> sounds;
+    for (auto &f : futureSounds) {
+        sounds.push_back(f.get());
+    }
     auto theme = sdlLoadMusic("../music/battle.ogg");
 
-    drawHexGrid();
-    drawBowman(bowFired);
-    drawMarshal(swordSwing, marshalHit);
-    drawEnemy1(archerHit);
-    drawEnemy2(swordSwing, gruntHit);
+    // Units go on top of the grid, and attackers on top of other units.
+    DrawList drawList(window);
+    drawHexGrid(drawList);
+    timeline.draw(drawList, 1);
+    drawList.draw();
     sdlPlayMusic(theme);
     SDL_UpdateRect(screen, 0, 0, 0, 0);
 
+    // Animations run on simulated time in fixed steps so they play back the
+    // same no matter how long each frame takes to draw.
+    SdlFrameClock clock;
+    SdlFixedStep sim;
     bool isDone = false;
     SDL_Event event;
     while (!isDone) {
-        while (SDL_PollEvent(&event)) {
+        sim.advance(clock.tick());
+        while (clock.pollEvent(event, !timeline.busy())) {
             if (event.type == SDL_QUIT) {
                 Mix_HaltMusic();
                 Mix_HaltChannel(-1);
                 isDone = true;
             }
             else if (event.type == SDL_MOUSEBUTTONUP) {
-                handleMouseUp(event.button);
+                handleMouseUp(event.button, timeline, sim.time_ms());
             }
         }
 
-        if (subject != Animating::NONE) {
-            sdlClear(window);
-            drawHexGrid();
-            drawBowman(bowFired);
-            drawMissile();
-            // order matters, we want the attacker drawn on top
-            if (subject == Animating::MARSHAL) {
-                drawEnemy2(swordSwing, gruntHit);
-                drawMarshal(swordSwing, marshalHit);
-            }
-            else {
-                drawMarshal(swordSwing, marshalHit);
-                drawEnemy2(swordSwing, gruntHit);
+        // Checking before the update means we still draw the frame where
+        // the last clip ends.
+        bool animating = timeline.busy();
+        while (sim.step()) {
+            timeline.update(sim.time_ms());
+            int soundId = -1;
+            while (timeline.pollSound(soundId)) {
+                sdlPlaySound(sounds[soundId]);
             }
-            drawEnemy1(archerHit);
+        }
+
+        if (animating) {
+            sdlClear(window);
+            drawHexGrid(drawList);
+            timeline.draw(drawList, 1, sim.alpha());
+            drawList.draw();
             SDL_UpdateRect(screen, 0, 0, 0, 0);
         }
 
-        SDL_Delay(1);
+        clock.wait();
     }
 
     return EXIT_SUCCESS;
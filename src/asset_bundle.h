@@ -0,0 +1,59 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#include "SDL_stdinc.h"
+
+// File layout for asset bundles written by mkbundle and read by
+// sdlLoadBundle().  A bundle holds images and sounds that have already been
+// decoded, so loading them is just a copy out of memory.
+//
+//     BundleHeader
+//     BundleEntry[numEntries]
+//     names, not null-terminated
+//     data, each block aligned to bundleAlign bytes
+//
+// Everything is stored in the byte order of the machine that built it.
+// Images are 32-bit pixels in the sdlCreateSurface() layout.  Sounds are raw
+// samples in the mixer's output format, which is recorded in the header so
+// a bundle built for a different audio setup can be detected.
+
+const char bundleMagic[4] = {'S', 'D', 'L', 'B'};
+const Uint32 bundleVersion = 1;
+const Uint32 bundleAlign = 16;
+
+enum class BundleType : Uint32 { IMAGE, SOUND };
+
+struct BundleHeader
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 numEntries;
+    Sint32 audioFreq;
+    Uint16 audioFormat;
+    Uint16 audioChannels;
+};
+
+struct BundleEntry
+{
+    BundleType type;
+    Uint32 nameOffset;  // from start of file
+    Uint32 nameLen;
+    Uint32 width;  // images only
+    Uint32 height;
+    Uint32 dataOffset;  // from start of file
+    Uint32 dataSize;
+};
+
+#endif
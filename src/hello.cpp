@@ -133,13 +133,10 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
 
     bool isDone = false;
     SDL_Event event;
-    while (!isDone) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                isDone = true;
-            }
+    while (!isDone && SDL_WaitEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            isDone = true;
         }
-        SDL_Delay(1);
     }
 
     SDL_FreeSurface(text);
@@ -0,0 +1,37 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "hex_cube.h"
+
+// Keep these loops free of branches and calls that won't inline so they
+// vectorize.
+void hexDistances(const Point &hex, const Sint16 *hx, const Sint16 *hy,
+                  int n, Sint16 *dist)
+{
+    auto c = cubeFromHex(hex);
+    for (int i = 0; i < n; ++i) {
+        dist[i] = cubeDist(c, cubeFromHex(hx[i], hy[i]));
+    }
+}
+
+void hexNeighbors(const Sint16 *hx, const Sint16 *hy, int n, Dir d,
+                  Sint16 *nx, Sint16 *ny)
+{
+    auto di = static_cast<int>(d);
+    Sint16 stepX = hexDirX[di];
+    Sint16 stepEven = hexDirY[0][di];
+    Sint16 stepOdd = hexDirY[1][di];
+    for (int i = 0; i < n; ++i) {
+        nx[i] = hx[i] + stepX;
+        ny[i] = hy[i] + stepEven + (hx[i] & 1) * (stepOdd - stepEven);
+    }
+}
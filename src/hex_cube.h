@@ -0,0 +1,129 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#ifndef HEX_CUBE_H
+#define HEX_CUBE_H
+
+#include "hex_utils.h"
+
+// Cube coordinates for the hex grid.  Points use offset coordinates: columns
+// are staggered, with odd columns shifted down half a hex, so the neighbors of
+// a hex depend on which kind of column it's in.  In cube coordinates each hex
+// has three coordinates that sum to zero and every step changes two of them by
+// one.  Neighbor offsets are the same everywhere, and distance is the largest
+// change along any axis.  Only two coordinates are stored, the third is
+// implied (axial coordinates).
+// source: http://www.redblobgames.com/grids/hexagons/
+//
+// Everything here is constexpr so it can be used to build tables and checked
+// at compile time.
+struct CubeHex
+{
+    int q;  // same as the column
+    int r;
+
+    constexpr int s() const { return -q - r; }
+};
+
+constexpr bool operator==(const CubeHex &lhs, const CubeHex &rhs)
+{
+    return lhs.q == rhs.q && lhs.r == rhs.r;
+}
+
+constexpr CubeHex operator+(const CubeHex &lhs, const CubeHex &rhs)
+{
+    return {lhs.q + rhs.q, lhs.r + rhs.r};
+}
+
+constexpr CubeHex operator-(const CubeHex &lhs, const CubeHex &rhs)
+{
+    return {lhs.q - rhs.q, lhs.r - rhs.r};
+}
+
+// Half the column, rounded down.  Unlike testing hx % 2, this works for
+// negative columns too.
+constexpr int cubeColumnShift(int hx)
+{
+    return (hx - (hx & 1)) / 2;
+}
+
+constexpr CubeHex cubeFromHex(int hx, int hy)
+{
+    return {hx, hy - cubeColumnShift(hx)};
+}
+
+constexpr CubeHex cubeFromHex(const Point &hex)
+{
+    return cubeFromHex(hex.first, hex.second);
+}
+
+constexpr Point hexFromCube(const CubeHex &c)
+{
+    return Point(static_cast<Sint16>(c.q),
+                 static_cast<Sint16>(c.r + cubeColumnShift(c.q)));
+}
+
+// std::abs isn't constexpr.
+constexpr int cubeAbs(int n)
+{
+    return n < 0 ? -n : n;
+}
+
+constexpr int cubeDist(const CubeHex &c1, const CubeHex &c2)
+{
+    return (cubeAbs(c1.q - c2.q) + cubeAbs(c1.r - c2.r) +
+            cubeAbs(c1.s() - c2.s())) / 2;
+}
+
+const int numDirs = static_cast<int>(Dir::_last);
+
+// Step to the adjacent hex in each direction, indexed by Dir.
+constexpr CubeHex cubeDirs[numDirs] =
+    {{0, -1}, {1, -1}, {1, 0}, {0, 1}, {-1, 1}, {-1, 0}};
+
+// The same steps in offset coordinates.  The y step depends on whether the
+// column is even or odd, so it's indexed by [column & 1][Dir].
+constexpr Sint16 hexDirX[numDirs] = {0, 1, 1, 0, -1, -1};
+constexpr Sint16 hexDirY[2][numDirs] =
+    {{-1, -1, 0, 1, 0, -1},
+     {-1, 0, 1, 1, 1, 0}};
+
+// The adjacent hex in direction d.  No bounds checking.
+constexpr Point hexStep(const Point &hex, int d)
+{
+    return Point(hex.first + hexDirX[d],
+                 hex.second + hexDirY[hex.first & 1][d]);
+}
+
+// Check that the offset and cube tables agree in both kinds of column.
+constexpr bool hexDirsMatch(int hx, int d)
+{
+    return cubeFromHex(hexStep(Point(hx, 0), d)) - cubeFromHex(hx, 0) ==
+        cubeDirs[d];
+}
+constexpr bool hexDirsMatch(int d = 0)
+{
+    return d == numDirs ||
+        (hexDirsMatch(0, d) && hexDirsMatch(1, d) && hexDirsMatch(-1, d) &&
+         hexDirsMatch(d + 1));
+}
+static_assert(hexDirsMatch(), "hex direction tables don't match");
+
+// Batch versions for arrays of hexes.  The hexes are stored as separate x and
+// y arrays so the compiler can vectorize the loops.  Output arrays must not
+// overlap the inputs.  Unlike hexDist(), hInvalid isn't handled.
+void hexDistances(const Point &hex, const Sint16 *hx, const Sint16 *hy,
+                  int n, Sint16 *dist);
+void hexNeighbors(const Sint16 *hx, const Sint16 *hy, int n, Dir d,
+                  Sint16 *nx, Sint16 *ny);
+
+#endif
@@ -11,9 +11,14 @@
     See the COPYING.txt file for more details.
 */
 #include "hex_utils.h"
+#include "hex_cube.h"
 #include <algorithm>
 #include <sstream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 bool operator==(const Point &lhs, const Point &rhs)
 {
     return lhs.first == rhs.first && lhs.second == rhs.second;
@@ -41,25 +46,13 @@ std::string str(const Point &p)
     return strm.str();
 }
 
-// source: Battle for Wesnoth, distance_between() in map_location.cpp.
 Sint16 hexDist(const Point &h1, const Point &h2)
 {
     if (h1 == hInvalid || h2 == hInvalid) {
         return Sint16_max;
     }
 
-    Sint16 dx = abs(h1.first - h2.first);
-    Sint16 dy = abs(h1.second - h2.second);
-
-    // Since the x-axis of the hex grid is staggered, we need to add a step in
-    // certain cases.
-    Sint16 vPenalty = 0;
-    if ((h1.second < h2.second && h1.first % 2 == 0 && h2.first % 2 == 1) ||
-        (h1.second > h2.second && h1.first % 2 == 1 && h2.first % 2 == 0)) {
-        vPenalty = 1;
-    }
-
-    return std::max<Sint16>(dx, dy + vPenalty + dx / 2);
+    return cubeDist(cubeFromHex(h1), cubeFromHex(h2));
 }
 
 Point adjacent(const Point &hSrc, Dir d)
@@ -120,3 +113,66 @@ int findClosest(const Point &hTarget, const std::vector<Point> &hexes)
 
     return closest;
 }
+
+int findClosest(const Point &hTarget, const Sint16 *hx, const Sint16 *hy,
+                int n)
+{
+    if (hTarget == hInvalid) {
+        return -1;
+    }
+
+    int closest = -1;
+    Sint16 bestSoFar = Sint16_max;
+    int i = 0;
+#ifdef __SSE2__
+    // Same math as cubeDist(), 8 hexes at a time.  The third cube coordinate
+    // is implied, so use the max of the three differences rather than half
+    // their sum.  Saturating math makes hInvalid come out as Sint16_max, the
+    // same as hexDist().
+    auto c = cubeFromHex(hTarget);
+    const __m128i tq = _mm_set1_epi16(c.q);
+    const __m128i tr = _mm_set1_epi16(c.r);
+    const __m128i zero = _mm_setzero_si128();
+    auto abs16 = [&] (__m128i v) {
+        return _mm_max_epi16(v, _mm_subs_epi16(zero, v));
+    };
+    __m128i best = _mm_set1_epi16(bestSoFar);
+    for (; i + 8 <= n; i += 8) {
+        auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hx + i));
+        auto y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hy + i));
+        auto r = _mm_subs_epi16(y, _mm_srai_epi16(x, 1));
+        auto dq = _mm_subs_epi16(x, tq);
+        auto dr = _mm_subs_epi16(r, tr);
+        auto dist = _mm_max_epi16(_mm_max_epi16(abs16(dq), abs16(dr)),
+                                  abs16(_mm_adds_epi16(dq, dr)));
+
+        // Usually none of these hexes are closer than what we've found.
+        if (_mm_movemask_epi8(_mm_cmplt_epi16(dist, best)) == 0) continue;
+
+        // Find the smallest distance by folding the lanes in half three
+        // times, then take the first lane with that distance.
+        auto m = _mm_shuffle_epi32(dist, _MM_SHUFFLE(1, 0, 3, 2));
+        m = _mm_min_epi16(dist, m);
+        m = _mm_min_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm_min_epi16(m, _mm_srli_epi32(m, 16));
+        bestSoFar = _mm_extract_epi16(m, 0);
+        best = _mm_set1_epi16(bestSoFar);
+
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(dist, best));
+        int lane = 0;
+        for (; (mask & 1) == 0; ++lane, mask >>= 2) {}
+        closest = i + lane;
+    }
+#endif
+
+    // Leftover hexes, or everything if we don't have SSE2.
+    for (; i < n; ++i) {
+        Sint16 dist = hexDist(hTarget, Point{hx[i], hy[i]});
+        if (dist < bestSoFar) {
+            closest = i;
+            bestSoFar = dist;
+        }
+    }
+
+    return closest;
+}
@@ -60,4 +60,9 @@ Point adjacent(const Point &hSrc, Dir d);
 // Given a list of hexes, return the index of the hex closest to the target.
 int findClosest(const Point &hTarget, const std::vector<Point> &hexes);
 
+// Same, for n hexes stored as separate x and y arrays.  This is much faster
+// for long lists since it checks 8 hexes at a time.
+int findClosest(const Point &hTarget, const Sint16 *hx, const Sint16 *hy,
+                int n);
+
 #endif
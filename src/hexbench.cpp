@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "hex_cube.h"
+#include "hex_utils.h"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Micro-benchmarks for the hex math.  Compare calling hexDist(), adjacent(),
+// and findClosest() one hex at a time with the batch versions over the same
+// hexes.
+//
+//     hexbench [map width]
+
+namespace
+{
+    // Run a test enough times to take a measurable amount of time and report
+    // the average per hex.  The checksum keeps the work from being optimized
+    // away.
+    void timeIt(const char *name, int numHexes, std::function<int ()> func)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const int reps = 200;
+        int checksum = 0;
+
+        auto start = Clock::now();
+        for (int i = 0; i < reps; ++i) {
+            checksum += func();
+        }
+        auto elapsed = Clock::now() - start;
+
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        std::cout << std::setw(28) << std::left << name << std::fixed <<
+            std::setprecision(2) << ns / reps / numHexes << " ns/hex  (" <<
+            checksum << ")\n";
+    }
+}
+
+extern "C" int SDL_main(int argc, char *argv[])
+{
+    Sint16 width = (argc > 1) ? std::atoi(argv[1]) : 100;
+    if (width <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [map width]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Point> hexes;
+    std::vector<Sint16> hx, hy;
+    for (Sint16 x = 0; x < width; ++x) {
+        for (Sint16 y = 0; y < width; ++y) {
+            hexes.emplace_back(x, y);
+            hx.push_back(x);
+            hy.push_back(y);
+        }
+    }
+    int n = hexes.size();
+    Point target{width / 2, width / 3};
+    std::vector<Sint16> out1(n), out2(n);
+
+    timeIt("hexDist", n, [&] {
+        for (int i = 0; i < n; ++i) {
+            out1[i] = hexDist(target, hexes[i]);
+        }
+        return out1[n - 1];
+    });
+    timeIt("hexDistances", n, [&] {
+        hexDistances(target, hx.data(), hy.data(), n, out1.data());
+        return out1[n - 1];
+    });
+    timeIt("adjacent (6 dirs)", n, [&] {
+        int sum = 0;
+        for (auto d : Dir()) {
+            for (int i = 0; i < n; ++i) {
+                auto hex = adjacent(hexes[i], d);
+                out1[i] = hex.first;
+                out2[i] = hex.second;
+            }
+            sum += out2[n - 1];
+        }
+        return sum;
+    });
+    timeIt("hexNeighbors (6 dirs)", n, [&] {
+        int sum = 0;
+        for (auto d : Dir()) {
+            hexNeighbors(hx.data(), hy.data(), n, d, out1.data(), out2.data());
+            sum += out2[n - 1];
+        }
+        return sum;
+    });
+
+    // Nearest of many candidates, such as the region centers when generating
+    // a random map.
+    for (int numCandidates : {18, 64, 256}) {
+        std::vector<Point> candidates;
+        std::vector<Sint16> cx, cy;
+        for (int i = 0; i < numCandidates; ++i) {
+            candidates.push_back(hexes[(i * 7919) % n]);
+            cx.push_back(candidates.back().first);
+            cy.push_back(candidates.back().second);
+        }
+
+        auto name = "findClosest x" + std::to_string(numCandidates);
+        timeIt(name.c_str(), n, [&] {
+            int sum = 0;
+            for (int i = 0; i < n; ++i) {
+                sum += findClosest(hexes[i], candidates);
+            }
+            return sum;
+        });
+        name += " (arrays)";
+        timeIt(name.c_str(), n, [&] {
+            int sum = 0;
+            for (int i = 0; i < n; ++i) {
+                sum += findClosest(hexes[i], cx.data(), cy.data(),
+                                   numCandidates);
+            }
+            return sum;
+        });
+    }
+
+    return EXIT_SUCCESS;
+}
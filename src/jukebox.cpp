@@ -10,23 +10,84 @@
  
     See the COPYING.txt file for more details.
 */
+#include "FileScanner.h"
+#include "MusicPlayer.h"
 #include "gui.h"
 #include "sdl_helper.h"
 #include <cassert>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
-#define BOOST_FILESYSTEM_NO_DEPRECATED
-#define BOOST_SYSTEM_NO_DEPRECATED
-#include "boost/filesystem.hpp"
-
-struct MusicInfo
+class Playlist
 {
-    std::string path;
-    SdlMusic music;
+public:
+    Playlist();
+
+    // Tracks can be added at any time, such as while a scan is running.
+    void add(const std::vector<std::string> &paths);
+
+    bool empty() const;
+    const std::string & title() const;
+    const std::string & nextTitle() const;
+
+    void next();
+    void prev();
+
+private:
+    std::vector<std::string> paths_;
+    int current_;
 };
 
+Playlist::Playlist()
+    : paths_(),
+    current_(0)
+{
+}
+
+void Playlist::add(const std::vector<std::string> &paths)
+{
+    paths_.insert(std::end(paths_), std::begin(paths), std::end(paths));
+}
+
+bool Playlist::empty() const
+{
+    return paths_.empty();
+}
+
+const std::string & Playlist::title() const
+{
+    assert(!empty());
+    return paths_[current_];
+}
+
+const std::string & Playlist::nextTitle() const
+{
+    assert(!empty());
+    return paths_[(current_ + 1) % paths_.size()];
+}
+
+void Playlist::next()
+{
+    current_ = (current_ + 1) % paths_.size();
+}
+
+void Playlist::prev()
+{
+    current_ = (current_ + paths_.size() - 1) % paths_.size();
+}
+
+// Format a time as m:ss.
+std::string timeStr(Uint32 ms)
+{
+    auto sec = ms / 1000;
+    std::ostringstream str;
+    str << sec / 60 << ':' << std::setw(2) << std::setfill('0') << sec % 60;
+    return str.str();
+}
+
 void handleMouseUp(const SDL_MouseButtonEvent &event,
                    std::vector<GuiButton *> buttons)
 {
@@ -41,25 +102,6 @@ void handleMouseUp(const SDL_MouseButtonEvent &event,
     }
 }
 
-std::vector<MusicInfo> getMusicFiles(const char *dir)
-{
-    namespace bfs = boost::filesystem;
-
-    bfs::path p(dir);
-    if (!exists(p) || !is_directory(p)) {
-        return {};
-    }
-
-    std::vector<MusicInfo> files;
-    for (bfs::directory_iterator i(p); i != bfs::directory_iterator(); ++i) {
-        bfs::path rawPath = i->path();
-        std::string path = rawPath.make_preferred().string();
-        files.emplace_back(MusicInfo{path, sdlLoadMusic(path)});
-    }
-
-    return files;
-}
-
 extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
 {
     if (!sdlInit(250, 140, "../img/icon.png", "Music Test")) {
@@ -79,82 +121,98 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
 
     auto font = sdlLoadFont("../DejaVuSans.ttf", 14);
     auto white = SDL_Color{255, 255, 255, 0};
-    sdlDrawText(font, "Now playing:", SDL_Rect{10, 10, 230, 20}, white);
+    sdlDrawText(font, "Now playing:", SDL_Rect{10, 10, 150, 20}, white);
 
     auto trackTitle = SDL_Rect{10, 30, 230, 50};
     sdlDrawText(font, "Nothing", trackTitle, white);
+    auto trackPos = SDL_Rect{160, 10, 80, 20};
+    Uint32 shownPos_s = 0;
 
     SDL_UpdateRect(screen, 0, 0, 0, 0);
 
-    auto musicFiles = getMusicFiles("../music");
-    assert(!musicFiles.empty());
-
-    int trackNum = 0;
+    // Tracks show up in the playlist as the scan finds them.  No .mp3 files:
+    // SDL_mixer only decodes those through its own music player, which
+    // MusicPlayer replaces.
+    FileScanner scanner("../music", {".ogg"}, "../music.index");
+    Playlist playlist;
+    MusicPlayer player;
+
+    // Play the current track and start decoding the one after it.  Skipping
+    // ahead is instant since the start of that track is already decoded.
+    auto playTrack = [&] {
+        sdlDrawText(font, playlist.title(), trackTitle, white);
+        player.play(playlist.title());
+        player.queue(playlist.nextTitle());
+    };
 
     playButton.onClick([&] {
-        if (!Mix_PlayingMusic()) {  // have we started playing music at all
-            auto &track = musicFiles[trackNum];
-            sdlPlayMusic(track.music);
+        if (!player.isPlaying()) {  // have we started playing music at all
+            if (playlist.empty()) return;
+            playTrack();
             playButton.setImage(pause);
-            sdlDrawText(font, track.path, trackTitle, white);
         }
         else {
-            if (Mix_PausedMusic()) {
+            if (player.isPaused()) {
                 playButton.setImage(pause);
-                Mix_ResumeMusic();
+                player.resume();
             }
             else {
                 playButton.setImage(play);
-                Mix_PauseMusic();
+                player.pause();
             }
         }
     });
 
     nextTrack.onClick([&] {
-        if (!Mix_PlayingMusic()) return;
-
-        trackNum = (trackNum + 1) % musicFiles.size();
-        auto &track = musicFiles[trackNum];
-        sdlDrawText(font, track.path, trackTitle, white);
-        if (Mix_PausedMusic()) {
-            sdlPlayMusic(track.music);
-            Mix_PauseMusic();
-        }
-        else {
-            sdlPlayMusic(track.music);
-        }
+        if (!player.isPlaying()) return;
+
+        playlist.next();
+        playTrack();
     });
 
     prevTrack.onClick([&] {
-        if (!Mix_PlayingMusic()) return;
-
-        trackNum = (trackNum - 1) % musicFiles.size();
-        auto &track = musicFiles[trackNum];
-        sdlDrawText(font, track.path, trackTitle, white);
-        if (Mix_PausedMusic()) {
-            sdlPlayMusic(track.music);
-            Mix_PauseMusic();
-        }
-        else {
-            sdlPlayMusic(track.music);
-        }
+        if (!player.isPlaying()) return;
+
+        playlist.prev();
+        playTrack();
     });
 
+    // Music plays on its own.  Once the scan is done, the only reasons to
+    // wake up are user input and keeping the track position up to date, so
+    // a slow frame rate is plenty.
+    SdlFrameClock clock(10);
     bool isDone = false;
     SDL_Event event;
     while (!isDone) {
-        while (SDL_PollEvent(&event)) {
+        clock.tick();
+        bool scanDone = scanner.done();
+        playlist.add(scanner.poll());
+
+        // When one track runs into the next, queue up the one after that.
+        if (player.update()) {
+            playlist.next();
+            sdlDrawText(font, playlist.title(), trackTitle, white);
+            player.queue(playlist.nextTitle());
+        }
+        if (player.isPlaying() && player.position_ms() / 1000 != shownPos_s) {
+            shownPos_s = player.position_ms() / 1000;
+            sdlDrawText(font, timeStr(shownPos_s * 1000) + " / " +
+                        timeStr(player.length_ms()), trackPos, white);
+        }
+
+        bool idle = scanDone && (!player.isPlaying() || player.isPaused());
+        while (clock.pollEvent(event, idle)) {
             if (event.type == SDL_MOUSEBUTTONUP) {
                 handleMouseUp(event.button, buttons);
             }
             else if (event.type == SDL_QUIT) {
-                Mix_HaltMusic();
+                player.pause();
                 isDone = true;
             }
         }
 
         SDL_UpdateRect(screen, 0, 0, 0, 0);
-        SDL_Delay(1);
+        clock.wait();
     }
 
     return EXIT_SUCCESS;
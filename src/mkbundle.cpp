@@ -0,0 +1,159 @@
+/*
+    Copyright (C) 2012-2013 by Michael Kristofik <kristo605@gmail.com>
+    Part of the libsdl-demos project.
+ 
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    or at your option any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY.
+ 
+    See the COPYING.txt file for more details.
+*/
+#include "asset_bundle.h"
+#include "sdl_helper.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Build an asset bundle from a list of .png and .ogg files:
+//
+//     mkbundle ../assets.bundle ../img/*.png ../sounds/*.ogg
+//
+// Each file is stored under the name given on the command line, so run this
+// from the same directory as the programs that will use it.  Opens the mixer
+// the same way the other programs do so the samples match.
+
+namespace
+{
+    bool endsWith(const std::string &str, const std::string &suffix)
+    {
+        return str.size() >= suffix.size() &&
+            str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    Uint32 alignUp(Uint32 offset)
+    {
+        return (offset + bundleAlign - 1) / bundleAlign * bundleAlign;
+    }
+
+    bool readImage(const char *filename, BundleEntry &entry,
+                   std::vector<char> &data)
+    {
+        auto buf = sdlDecodeImage(filename);
+        if (buf.pixels.empty()) {
+            return false;
+        }
+
+        entry.type = BundleType::IMAGE;
+        entry.width = buf.w;
+        entry.height = buf.h;
+        auto bytes = reinterpret_cast<const char *>(buf.pixels.data());
+        data.assign(bytes, bytes + buf.pixels.size() * 4);
+        return true;
+    }
+
+    // Decode a sound into the mixer's output format.
+    bool readSound(const char *filename, BundleEntry &entry,
+                   std::vector<char> &data)
+    {
+        auto sound = sdlLoadSound(filename);
+        if (!sound) {
+            return false;
+        }
+
+        entry.type = BundleType::SOUND;
+        entry.width = 0;
+        entry.height = 0;
+        data.assign(sound->abuf, sound->abuf + sound->alen);
+        return true;
+    }
+}
+
+extern "C" int SDL_main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: mkbundle <output file> <image or sound>...\n";
+        return EXIT_FAILURE;
+    }
+    if (!sdlInit(1, 1, "../img/icon.png", "mkbundle")) {
+        return EXIT_FAILURE;
+    }
+
+    BundleHeader header;
+    memcpy(header.magic, bundleMagic, sizeof(bundleMagic));
+    header.version = bundleVersion;
+    header.numEntries = 0;
+    int channels = 0;
+    if (Mix_QuerySpec(&header.audioFreq, &header.audioFormat, &channels) == 0) {
+        std::cerr << "Error querying audio format: " << Mix_GetError() << '\n';
+        return EXIT_FAILURE;
+    }
+    header.audioChannels = channels;
+
+    std::vector<std::string> names;
+    std::vector<BundleEntry> entries;
+    std::vector<std::vector<char>> blocks;
+    for (int i = 2; i < argc; ++i) {
+        std::string name = argv[i];
+        BundleEntry entry;
+        std::vector<char> data;
+        bool ok = false;
+        if (endsWith(name, ".png")) {
+            ok = readImage(argv[i], entry, data);
+        }
+        else if (endsWith(name, ".ogg") || endsWith(name, ".wav")) {
+            ok = readSound(argv[i], entry, data);
+        }
+        else {
+            std::cerr << "Warning: skipping unknown file type " << name << '\n';
+        }
+        if (!ok) continue;
+
+        names.push_back(name);
+        entries.push_back(entry);
+        blocks.push_back(std::move(data));
+    }
+    header.numEntries = entries.size();
+
+    // Lay out the names after the entry table, then the data blocks.
+    Uint32 offset = sizeof(BundleHeader) + entries.size() * sizeof(BundleEntry);
+    for (auto i = 0u; i < entries.size(); ++i) {
+        entries[i].nameOffset = offset;
+        entries[i].nameLen = names[i].size();
+        offset += names[i].size();
+    }
+    for (auto i = 0u; i < entries.size(); ++i) {
+        offset = alignUp(offset);
+        entries[i].dataOffset = offset;
+        entries[i].dataSize = blocks[i].size();
+        offset += blocks[i].size();
+    }
+
+    std::ofstream out(argv[1], std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              entries.size() * sizeof(BundleEntry));
+    Uint32 pos = sizeof(BundleHeader) + entries.size() * sizeof(BundleEntry);
+    for (const auto &name : names) {
+        out.write(name.data(), name.size());
+        pos += name.size();
+    }
+    for (auto i = 0u; i < entries.size(); ++i) {
+        std::vector<char> padding(entries[i].dataOffset - pos, 0);
+        out.write(padding.data(), padding.size());
+        out.write(blocks[i].data(), blocks[i].size());
+        pos = entries[i].dataOffset + blocks[i].size();
+    }
+    if (!out) {
+        std::cerr << "Error writing " << argv[1] << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Wrote " << entries.size() << " assets (" << offset
+        << " bytes) to " << argv[1] << '\n';
+    return EXIT_SUCCESS;
+}
@@ -22,10 +22,10 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <memory>
-#include <numeric>
 #include <vector>
 
 namespace
@@ -45,6 +45,11 @@ namespace
     Point nextHex;  // where to move the selected hex
     Point pathToHex;  // highlight a path to here
     Point pathToHexPrev;
+
+    // Press 'r' to show how far you could move from the selected hex.
+    const int moveRange = 5;
+    bool showRange = false;
+    bool rangeChanged = false;
 }
 
 // Try to center the minimap's bounding box at the given screen coordinates,
@@ -63,15 +68,15 @@ void moveMiniBoxCenter(Sint16 px, Sint16 py)
     nextMapLoc = {tgtMapX, tgtMapY};
 }
 
-void scrollMap(Dir8 direction)
+// Scroll the map by one simulation step.  May be called several times before
+// the map is redrawn.
+void scrollMap(Dir8 direction, const SdlFixedStep &sim)
 {
     const Sint16 mapScrollRate_pps = pHexSize * 4;  // pixels per second
-    const Sint16 pScroll = std::max<Sint16>(1, mapScrollRate_pps * elapsed_ms /
-                                               1000);
-    const Sint16 pScrollDiag = std::max<Sint16>(1,
-        mapScrollRate_pps * elapsed_ms / 1000 / std::sqrt(2));
+    const Sint16 pScroll = sim.perStep(mapScrollRate_pps);
+    const Sint16 pScrollDiag = sim.perStep(mapScrollRate_pps / std::sqrt(2));
 
-    auto curPixel = rmap->mDrawnAt();
+    auto curPixel = nextMapLoc;
     Sint16 px = curPixel.first;
     Sint16 py = curPixel.second;
     auto maxPixel = rmap->maxPixel();
@@ -132,6 +137,18 @@ void handleMouseDown(const SDL_MouseButtonEvent &event)
         insideRect(event.x, event.y, mapArea)) {
         nextHex = rmap->getHexAtS(event.x, event.y);
     }
+
+    // Middle click cycles through the terrain types, to test map editing.
+    if (event.button == SDL_BUTTON_MIDDLE && mini->isReady() &&
+        insideRect(event.x, event.y, mapArea))
+    {
+        auto hex = rmap->getHexAtS(event.x, event.y);
+        auto terrain = rmap->getTerrain(hex);
+        if (terrain >= 0) {
+            rmap->setTerrain(hex, (terrain + 1) % NUM_TERRAINS);
+            rmap->redraw();
+        }
+    }
 }
 
 // If the user has clicked inside the minimap, moving the mouse will drag the
@@ -168,9 +185,15 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
     if (!sdlInit(1112, 704, "../img/icon.png", "Random Map Test")) {
         return EXIT_FAILURE;
     }
+    sdlLoadBundle("../assets.bundle");  // optional, see mkbundle.cpp
 
-    rmap = make_unique<RandomMap>(32, 18, mapArea);
-    mini = make_unique<Minimap>(*rmap, minimapArea);
+    // Generating the map takes a while.  Do it in the background so the
+    // window responds right away.  Loading the images needs the display, so
+    // that has to happen here.
+    RandomMap::loadTiles();
+    auto futureMap = std::async(std::launch::async, [] {
+        return make_unique<RandomMap>(32, 18, mapArea);
+    });
     timeNearEdge_ms = 0;
     mouseNearMapEdge = Dir8::None;
     pathToHex = hInvalid;
@@ -186,21 +209,39 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
     assert(str(m.getHexAtS(90, 144)) == str({1, 1}));
     */
 
-    rmap->draw(0, 0);
-    mini->draw();
-    miniBox = mini->drawBoundingBox();
     SDL_UpdateRect(screen, 0, 0, 0, 0);
 
-    std::vector<Uint32> frames;
+    SdlFrameClock clock;
+    SdlFixedStep sim;
     bool isDone = false;
-    auto prevFrameTime_ms = SDL_GetTicks();
     SDL_Event event;
+    bool miniDone = false;
     while (!isDone) {
-        auto curTime_ms = SDL_GetTicks();
-        elapsed_ms = curTime_ms - prevFrameTime_ms;
-        prevFrameTime_ms = curTime_ms;
-        if (!frames.empty() || elapsed_ms > 0) {  // skip zeroth frame
-            frames.push_back(elapsed_ms);
+        elapsed_ms = clock.tick();
+        sim.advance(elapsed_ms);
+
+        // Show the map as soon as it's ready.  The minimap draws a
+        // placeholder until its own background work finishes.
+        if (!rmap && isReady(futureMap)) {
+            rmap = futureMap.get();
+            mini = make_unique<Minimap>(*rmap, minimapArea);
+            rmap->onChange([] (const std::vector<Point> &hexes) {
+                mini->update(hexes);
+                mini->draw();
+                mini->drawBoundingBox();
+            });
+            rmap->draw(0, 0);
+            mini->draw();
+            miniBox = mini->drawBoundingBox();
+        }
+        if (!rmap) {
+            while (clock.pollEvent(event, false)) {
+                if (event.type == SDL_QUIT) {
+                    isDone = true;
+                }
+            }
+            clock.wait();
+            continue;
         }
 
         nextMapLoc = rmap->mDrawnAt();
@@ -215,11 +256,16 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
         else {
             timeNearEdge_ms = 0;
         }
-        if (timeNearEdge_ms > 1000) {
-            scrollMap(mouseNearMapEdge);
+        while (sim.step()) {
+            if (timeNearEdge_ms > 1000) {
+                scrollMap(mouseNearMapEdge, sim);
+            }
         }
 
-        while (SDL_PollEvent(&event)) {
+        // Nothing moves on its own unless the mouse is near an edge or we're
+        // still waiting on the minimap.
+        bool idle = (mouseNearMapEdge == Dir8::None && miniDone);
+        while (clock.pollEvent(event, idle)) {
             if (event.type == SDL_MOUSEBUTTONDOWN) {
                 handleMouseDown(event.button);
             }
@@ -229,6 +275,17 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
             else if (event.type == SDL_MOUSEBUTTONUP) {
                 handleMouseUp(event.button);
             }
+            else if (event.type == SDL_KEYUP &&
+                     event.key.keysym.sym == SDLK_f)
+            {
+                clock.printStats(std::cout);
+            }
+            else if (event.type == SDL_KEYUP &&
+                     event.key.keysym.sym == SDLK_r)
+            {
+                showRange = !showRange;
+                rangeChanged = true;
+            }
             else if (event.type == SDL_QUIT) {
                 isDone = true;
             }
@@ -236,21 +293,31 @@ extern "C" int SDL_main(int, char **)  // 2-arg form is required by SDL
 
         if (nextMapLoc != rmap->mDrawnAt() ||
             nextHex != rmap->getSelectedHex() ||
-            pathToHex != pathToHexPrev)
+            pathToHex != pathToHexPrev ||
+            rangeChanged)
         {
+            if (nextHex != rmap->getSelectedHex() || rangeChanged) {
+                rmap->highlightRange(showRange ?
+                                     rmap->reachableWithin(nextHex, moveRange) :
+                                     std::vector<Point>());
+                rangeChanged = false;
+            }
             rmap->selectHex(nextHex);
             rmap->highlightPath(rmap->getSelectedHex(), pathToHex);
             rmap->draw(nextMapLoc.first, nextMapLoc.second);
             mini->draw();
             mini->drawBoundingBox();
         }
+        if (!miniDone && mini->isReady()) {
+            mini->draw();
+            mini->drawBoundingBox();
+            miniDone = true;
+        }
 
         SDL_UpdateRect(screen, 0, 0, 0, 0);
-        SDL_Delay(1);
+        clock.wait();
     }
 
-    std::cout << "Average frame time: " << accumulate(std::begin(frames), std::end(frames), 0) / static_cast<double>(frames.size()) << '\n';
-    std::cout << "Minimum frame: " << *min_element(std::begin(frames), std::end(frames)) << '\n';
-    std::cout << "Maximum frame: " << *max_element(std::begin(frames), std::end(frames)) << '\n';
+    clock.printStats(std::cout);
     return EXIT_SUCCESS;
 }
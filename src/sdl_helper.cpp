@@ -11,17 +11,47 @@
     See the COPYING.txt file for more details.
 */
 #include "sdl_helper.h"
+#include "algo.h"
+#include "asset_bundle.h"
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
-#include "boost/tokenizer.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 SDL_Surface *screen = nullptr;
 
 namespace
 {
+    // SDL interprets each pixel as a 32-bit number, so our masks must depend
+    // on the endianness (byte order) of the machine.
+    // source: SDL_CreateRGBSurface documentation.
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    const int rshift = 24;
+    const int gshift = 16;
+    const int bshift = 8;
+    const int ashift = 0;
+#else
+    const int rshift = 0;
+    const int gshift = 8;
+    const int bshift = 16;
+    const int ashift = 24;
+#endif
+    const Uint32 rmask = 0xFFu << rshift;
+    const Uint32 gmask = 0xFFu << gshift;
+    const Uint32 bmask = 0xFFu << bshift;
+    const Uint32 amask = 0xFFu << ashift;
+
     using DashSize = std::pair<Sint16, Uint16>;  // line-relative pos, width
     std::vector<DashSize> dashedLine(Uint16 lineLen)
     {
@@ -44,75 +74,373 @@ namespace
         return dashes;
     }
 
-    // Break a string into multiple lines based on rendered line length.
-    // Return one string per line.
-    std::vector<std::string> wordWrap(const SdlFont &font,
-                                      const std::string &txt, int lineLen)
+    // Everything needed to draw one character of a font.  The coverage mask
+    // doesn't depend on color, so one set of glyphs serves every color.
+    struct Glyph
+    {
+        bool loaded = false;
+        int minx = 0;  // offset of the mask from the pen position
+        int maxy = 0;  // height of the mask above the baseline
+        int advance = 0;
+        Sint16 w = 0;
+        Sint16 h = 0;
+        std::vector<Uint8> alpha;  // coverage, w * h
+    };
+
+    // Glyphs for each font, indexed by Latin-1 character code.
+    std::unordered_map<const TTF_Font *, std::vector<Glyph>> glyphCache;
+
+    // Finished blocks of text: font, text, line length, RGB color.
+    using TextKey = std::tuple<const TTF_Font *, std::string, int, Uint32>;
+    std::map<TextKey, SdlSurface> textCache;
+    std::deque<TextKey> textCacheOrder;  // oldest first
+    const size_t textCacheSize = 64;
+
+    const Glyph & getGlyph(TTF_Font *font, unsigned char c)
+    {
+        auto &glyphs = glyphCache[font];
+        if (glyphs.empty()) {
+            glyphs.resize(256);
+        }
+
+        auto &g = glyphs[c];
+        if (g.loaded) {
+            return g;
+        }
+        g.loaded = true;
+
+        int maxx = 0;
+        int miny = 0;
+        if (TTF_GlyphMetrics(font, c, &g.minx, &maxx, &miny, &g.maxy,
+                             &g.advance) < 0)
+        {
+            std::cerr << "Warning: no glyph for character " << int(c) << ": "
+                << TTF_GetError() << '\n';
+            return g;
+        }
+
+        // Whitespace has nothing to render.
+        SDL_Color white = {255, 255, 255, 0};
+        auto img = make_surface(TTF_RenderGlyph_Blended(font, c, white));
+        if (!img) {
+            return g;
+        }
+        g.w = img->w;
+        g.h = img->h;
+        g.alpha.resize(g.w * g.h);
+        SdlLock(img, [&] {
+            const auto fmt = img->format;
+            for (auto y = 0; y < g.h; ++y) {
+                auto row = reinterpret_cast<const Uint32 *>(
+                    static_cast<const Uint8 *>(img->pixels) + y * img->pitch);
+                for (auto x = 0; x < g.w; ++x) {
+                    g.alpha[y * g.w + x] = (row[x] & fmt->Amask) >> fmt->Ashift;
+                }
+            }
+        });
+        return g;
+    }
+
+    // Lay out a string in one pass over the cached glyph advances and render
+    // it into a single image.  Lines break on spaces so that each is at most
+    // lineLen pixels wide, except that a word too long for any line gets one
+    // to itself.  Return a null surface if there's nothing to draw.
+    SdlSurface renderText(TTF_Font *font, const std::string &txt, int lineLen,
+                          const SDL_Color &color)
     {
         assert(lineLen > 0);
 
-        // First try: does it all fit on one line?
+        struct Placement
+        {
+            int x;
+            int y;
+            const Glyph *glyph;
+        };
+        std::vector<Placement> placed;
+
+        const auto lineSkip = TTF_FontLineSkip(font);
+        const auto ascent = TTF_FontAscent(font);
+        const auto spaceWidth = getGlyph(font, ' ').advance;
+        int penX = 0;
+        int lineY = 0;
+        bool lineEmpty = true;
+        size_t i = 0;
+        while (i < txt.size()) {
+            if (txt[i] == ' ') {
+                ++i;
+                continue;
+            }
+            auto end = std::min(txt.find(' ', i), txt.size());
+
+            int wordWidth = 0;
+            for (auto j = i; j < end; ++j) {
+                wordWidth += getGlyph(font, txt[j]).advance;
+            }
+            if (!lineEmpty) {
+                if (penX + spaceWidth + wordWidth > lineLen) {
+                    penX = 0;
+                    lineY += lineSkip;
+                }
+                else {
+                    penX += spaceWidth;
+                }
+            }
+
+            for (auto j = i; j < end; ++j) {
+                const auto &g = getGlyph(font, txt[j]);
+                placed.push_back({penX + g.minx, lineY + ascent - g.maxy, &g});
+                penX += g.advance;
+            }
+            lineEmpty = false;
+            i = end;
+        }
+
         int width = 0;
-        if (TTF_SizeText(font.get(), txt.c_str(), &width, 0) < 0) {
-            std::cerr << "Warning: problem rendering word wrap - " <<
-                TTF_GetError();
-            return {txt};
-        }
-        if (width <= lineLen) {
-            return {txt};
-        }
-
-        // Break up the string on spaces.
-        boost::char_separator<char> sep{" "};
-        boost::tokenizer<boost::char_separator<char>> tokens{txt, sep};
-
-        // Doesn't matter if the first token fits, render it anyway.
-        auto tok = std::begin(tokens);
-        std::string strSoFar = *tok;
-        ++tok;
-
-        // Test rendering each word until we surpass the line length.
-        std::vector<std::string> lines;
-        while (tok != std::end(tokens)) {
-            std::string nextStr = strSoFar + " " + *tok;
-            TTF_SizeText(font.get(), nextStr.c_str(), &width, 0);
-            if (width > lineLen) {
-                lines.push_back(strSoFar);
-                strSoFar = *tok;
+        int height = 0;
+        for (const auto &p : placed) {
+            width = std::max(width, p.x + p.glyph->w);
+            height = std::max(height, p.y + p.glyph->h);
+        }
+        if (width <= 0 || height <= 0) {
+            return nullptr;
+        }
+
+        // Glyphs are all the same color, so combining them only involves the
+        // coverage.  Where they overlap, keep the stronger one.
+        std::vector<Uint8> coverage(width * height, 0);
+        for (const auto &p : placed) {
+            const auto &g = *p.glyph;
+            for (auto y = std::max(0, -p.y); y < g.h; ++y) {
+                auto dest = &coverage[(p.y + y) * width];
+                for (auto x = std::max(0, -p.x); x < g.w; ++x) {
+                    dest[p.x + x] = std::max(dest[p.x + x], g.alpha[y * g.w + x]);
+                }
+            }
+        }
+
+        SdlPixelBuffer buf(width, height);
+        auto rgb = (Uint32(color.r) << rshift) | (Uint32(color.g) << gshift) |
+            (Uint32(color.b) << bshift);
+        for (auto j = 0u; j < coverage.size(); ++j) {
+            buf.pixels[j] = rgb | (Uint32(coverage[j]) << ashift);
+        }
+        return sdlDisplayFormat(buf);
+    }
+
+    // Drop everything cached for a font before closing it, so a new font
+    // allocated at the same address doesn't pick up stale glyphs.
+    void closeFont(TTF_Font *font)
+    {
+        glyphCache.erase(font);
+        for (auto iter = std::begin(textCache); iter != std::end(textCache);) {
+            if (std::get<0>(iter->first) == font) {
+                iter = textCache.erase(iter);
             }
             else {
-                strSoFar = nextStr;
+                ++iter;
             }
-            ++tok;
         }
-
-        // Add remaining words.
-        lines.push_back(strSoFar);
-        return lines;
+        textCacheOrder.erase(std::remove_if(std::begin(textCacheOrder),
+                                            std::end(textCacheOrder),
+            [font] (const TextKey &key) { return std::get<0>(key) == font; }),
+            std::end(textCacheOrder));
+        TTF_CloseFont(font);
     }
 
-    SdlSurface deepCopy(const SdlSurface &src)
+    // Contents of the asset bundle, if any.  Sounds play straight out of the
+    // bundle memory, so each one holds a reference to it.
+    std::shared_ptr<std::vector<char>> bundleData;
+    std::unordered_map<std::string, BundleEntry> bundleEntries;
+
+    const BundleEntry * findInBundle(const char *filename, BundleType type)
     {
-        auto surf = SDL_ConvertSurface(src.get(), src->format, src->flags);
-        if (!surf) {
-            std::cerr << "Error copying surface: " << SDL_GetError() << '\n';
+        auto iter = bundleEntries.find(filename);
+        if (iter == std::end(bundleEntries) || iter->second.type != type) {
             return nullptr;
         }
-        return make_surface(surf);
+        return &iter->second;
     }
 
-    // source: Battle for Wesnoth, flip_surface() in sdl_utils.cpp.
-    void flipH(SdlSurface &src, int frameStart, int frameWidth)
+    // Copy a row of pixels in reverse order.  The rows must not overlap.
+    void reverseRow(const Uint32 *src, Uint32 *dest, int len)
     {
-        auto pixels = static_cast<Uint32 *>(src->pixels);
-        for (auto y = 0; y < src->h; ++y) {
-            for (auto x = 0; x < frameWidth / 2; ++x) {
-                auto i1 = y * src->w + frameStart + x;
-                auto i2 = y * src->w + frameStart + frameWidth - x - 1;
-                std::swap(pixels[i1], pixels[i2]);
+        auto srcEnd = src + len;
+        int i = 0;
+#ifdef __SSE2__
+        for (; i + 4 <= len; i += 4) {
+            auto v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(srcEnd - i - 4));
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), v);
+        }
+#endif
+        for (; i < len; ++i) {
+            dest[i] = srcEnd[-i - 1];
+        }
+    }
+
+    // Blend a color into a row of pixels, a byte at a time:
+    //     dest = (dest * (256 - w) + color * w) / 256
+    // Each byte has its own weight so bytes that aren't a color channel can be
+    // left alone by giving them a weight of 0.
+    void tintRow(Uint32 *row, int len, Uint32 color,
+                 const std::array<Uint16, 4> &weights)
+    {
+        int x = 0;
+#ifdef __SSE2__
+        // Widen two pixels at a time to 16 bits per byte so the products
+        // don't overflow.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i w = _mm_set_epi16(weights[3], weights[2], weights[1],
+                                        weights[0], weights[3], weights[2],
+                                        weights[1], weights[0]);
+        const __m128i keep = _mm_sub_epi16(_mm_set1_epi16(256), w);
+        const __m128i add = _mm_mullo_epi16(
+            _mm_unpacklo_epi8(_mm_set1_epi32(color), zero), w);
+        auto blend = [&] (__m128i v) {
+            v = _mm_add_epi16(_mm_mullo_epi16(v, keep), add);
+            return _mm_srli_epi16(v, 8);
+        };
+        for (; x + 4 <= len; x += 4) {
+            auto dest = reinterpret_cast<__m128i *>(row + x);
+            auto p = _mm_loadu_si128(dest);
+            auto lo = blend(_mm_unpacklo_epi8(p, zero));
+            auto hi = blend(_mm_unpackhi_epi8(p, zero));
+            _mm_storeu_si128(dest, _mm_packus_epi16(lo, hi));
+        }
+#endif
+
+        // Leftover pixels, or everything if we don't have SSE2.
+        for (; x < len; ++x) {
+            Uint32 pixel = 0;
+            for (int i = 0; i < 4; ++i) {
+                Uint32 b = (row[x] >> (i * 8)) & 0xFF;
+                Uint32 c = (color >> (i * 8)) & 0xFF;
+                b = (b * (256 - weights[i]) + c * weights[i]) >> 8;
+                pixel |= b << (i * 8);
             }
+            row[x] = pixel;
+        }
+    }
+
+    // Read or write one pixel of a surface that isn't 32 bits per pixel.
+    Uint32 getPixel(const Uint8 *p, int bytesPerPixel)
+    {
+        switch (bytesPerPixel) {
+            case 1:
+                return *p;
+            case 2:
+                return *reinterpret_cast<const Uint16 *>(p);
+            case 3:
+                if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+                    return (p[0] << 16) | (p[1] << 8) | p[2];
+                }
+                return p[0] | (p[1] << 8) | (p[2] << 16);
+            default:
+                return *reinterpret_cast<const Uint32 *>(p);
+        }
+    }
+
+    void putPixel(Uint8 *p, int bytesPerPixel, Uint32 pixel)
+    {
+        switch (bytesPerPixel) {
+            case 1:
+                *p = pixel;
+                break;
+            case 2:
+                *reinterpret_cast<Uint16 *>(p) = pixel;
+                break;
+            case 3:
+                if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+                    p[0] = (pixel >> 16) & 0xFF;
+                    p[1] = (pixel >> 8) & 0xFF;
+                    p[2] = pixel & 0xFF;
+                }
+                else {
+                    p[0] = pixel & 0xFF;
+                    p[1] = (pixel >> 8) & 0xFF;
+                    p[2] = (pixel >> 16) & 0xFF;
+                }
+                break;
+            default:
+                *reinterpret_cast<Uint32 *>(p) = pixel;
+                break;
         }
     }
+
+    // tintRow() for screens of any other depth, such as a 16-bit desktop.
+    // Slower because each pixel is split into channels and mapped back, but
+    // it uses the same blend.
+    void tintRowAnyDepth(Uint8 *row, int len, const SDL_PixelFormat *fmt,
+                         const SDL_Color &color, Uint8 alpha)
+    {
+        auto blend = [alpha] (Uint8 dest, Uint8 c) {
+            return static_cast<Uint8>((dest * (256 - alpha) + c * alpha) >> 8);
+        };
+
+        const int bpp = fmt->BytesPerPixel;
+        for (int x = 0; x < len; ++x, row += bpp) {
+            Uint8 r = 0;
+            Uint8 g = 0;
+            Uint8 b = 0;
+            SDL_GetRGB(getPixel(row, bpp), fmt, &r, &g, &b);
+            putPixel(row, bpp, SDL_MapRGB(fmt, blend(r, color.r),
+                                          blend(g, color.g), blend(b, color.b)));
+        }
+    }
+
+    // Create an empty surface with the same pixel format and alpha setting as
+    // another one.
+    SdlSurface blankSurface(const SdlSurface &src, Sint16 width, Sint16 height)
+    {
+        const auto fmt = src->format;
+        auto surf = make_surface(SDL_CreateRGBSurface(SDL_SWSURFACE, width,
+            height, fmt->BitsPerPixel, fmt->Rmask, fmt->Gmask, fmt->Bmask,
+            fmt->Amask));
+        if (!surf) {
+            std::cerr << "Error creating new surface: " << SDL_GetError()
+                << '\n';
+            return nullptr;
+        }
+        SDL_SetAlpha(surf.get(), src->flags & SDL_SRCALPHA, fmt->alpha);
+        return surf;
+    }
+
+    bool sameFormat(const SdlSurface &a, const SdlSurface &b)
+    {
+        return a->format->BitsPerPixel == b->format->BitsPerPixel &&
+            a->format->Rmask == b->format->Rmask &&
+            a->format->Gmask == b->format->Gmask &&
+            a->format->Bmask == b->format->Bmask &&
+            a->format->Amask == b->format->Amask &&
+            (a->flags & SDL_SRCALPHA) == (b->flags & SDL_SRCALPHA);
+    }
+
+    // Copy a region of one surface into another, mirrored left-to-right, with
+    // the upper-left corner at (destX, 0).  Both must be 32 bits per pixel.
+    void mirrorRegion(SdlSurface src, const SDL_Rect &region, SdlSurface &dest,
+                      Sint16 destX)
+    {
+        assert(src->format->BytesPerPixel == 4);
+        assert(dest->format->BytesPerPixel == 4);
+
+        SdlLock(src, [&] {
+            SdlLock(dest, [&] {
+                auto srcPixels = static_cast<const Uint8 *>(src->pixels);
+                auto destPixels = static_cast<Uint8 *>(dest->pixels);
+                for (auto y = 0; y < region.h; ++y) {
+                    auto srcRow = reinterpret_cast<const Uint32 *>(srcPixels +
+                        (region.y + y) * src->pitch) + region.x;
+                    auto destRow = reinterpret_cast<Uint32 *>(destPixels +
+                        y * dest->pitch) + destX;
+                    reverseRow(srcRow, destRow, region.w);
+                }
+            });
+        });
+    }
+
+    // Reused by every mirrored blit.  It only grows.
+    SdlSurface mirrorScratch;
 }
 
 bool sdlInit(Sint16 winWidth, Sint16 winHeight, const char *iconPath,
@@ -167,36 +495,287 @@ bool sdlInit(Sint16 winWidth, Sint16 winHeight, const char *iconPath,
     return true;
 }
 
+const int SdlFrameClock::historySize_;
+
+SdlFrameClock::SdlFrameClock(int targetFps)
+    : period_ms_(1000 / std::max(1, targetFps)),
+    frameStart_ms_(SDL_GetTicks()),
+    deadline_ms_(frameStart_ms_ + period_ms_),
+    waitedThisFrame_(false),
+    history_(),
+    numFrames_(0),
+    next_(0)
+{
+}
+
+Uint32 SdlFrameClock::tick()
+{
+    auto now_ms = SDL_GetTicks();
+    auto elapsed_ms = now_ms - frameStart_ms_;
+    frameStart_ms_ = now_ms;
+    waitedThisFrame_ = false;
+
+    history_[next_] = elapsed_ms;
+    next_ = (next_ + 1) % historySize_;
+    numFrames_ = std::min(numFrames_ + 1, historySize_);
+
+    return elapsed_ms;
+}
+
+bool SdlFrameClock::pollEvent(SDL_Event &event, bool idle)
+{
+    if (!idle || waitedThisFrame_) {
+        return SDL_PollEvent(&event) == 1;
+    }
+
+    waitedThisFrame_ = true;
+    if (SDL_WaitEvent(&event) == 0) {
+        std::cerr << "Error waiting for event: " << SDL_GetError() << '\n';
+        return false;
+    }
+
+    // Time spent blocked doesn't count toward this frame, and there's no
+    // point in trying to catch up on frames we deliberately skipped.
+    frameStart_ms_ = SDL_GetTicks();
+    deadline_ms_ = frameStart_ms_;
+    return true;
+}
+
+void SdlFrameClock::wait()
+{
+    deadline_ms_ += period_ms_;
+
+    auto now_ms = SDL_GetTicks();
+    if (static_cast<Sint32>(deadline_ms_ - now_ms) > 0) {
+        SDL_Delay(deadline_ms_ - now_ms);
+    }
+    else {
+        // Running behind, start the next frame from now instead of trying to
+        // catch up.
+        deadline_ms_ = now_ms;
+    }
+}
+
+Uint32 SdlFrameClock::percentile(double pct) const
+{
+    if (numFrames_ == 0) {
+        return 0;
+    }
+
+    std::array<Uint32, historySize_> sorted(history_);
+    auto last = std::begin(sorted) + numFrames_;
+    auto nth = std::begin(sorted) +
+        bound(static_cast<int>(pct / 100 * numFrames_), 0, numFrames_ - 1);
+    std::nth_element(std::begin(sorted), nth, last);
+    return *nth;
+}
+
+void SdlFrameClock::printStats(std::ostream &os) const
+{
+    os << "Frame times over last " << numFrames_ << " frames (ms): p50 "
+        << percentile(50) << ", p95 " << percentile(95) << ", p99 "
+        << percentile(99) << '\n';
+}
+
+SdlFixedStep::SdlFixedStep(int stepsPerSec, int maxSteps)
+    : stepsPerSec_(std::max(1, stepsPerSec)),
+    maxBacklog_(1000 * std::max(1, maxSteps)),
+    backlog_(0),
+    numSteps_(0)
+{
+}
+
+void SdlFixedStep::advance(Uint32 elapsed_ms)
+{
+    // Measure in units that make each step exactly 1000, so there's no
+    // rounding error to drift over time.
+    auto elapsed = std::min<Uint32>(elapsed_ms, maxBacklog_) * stepsPerSec_;
+    backlog_ = std::min(backlog_ + elapsed, maxBacklog_);
+}
+
+bool SdlFixedStep::step()
+{
+    if (backlog_ < 1000) {
+        return false;
+    }
+    backlog_ -= 1000;
+    ++numSteps_;
+    return true;
+}
+
+Uint32 SdlFixedStep::time_ms() const
+{
+    return static_cast<Uint64>(numSteps_) * 1000 / stepsPerSec_;
+}
+
+double SdlFixedStep::alpha() const
+{
+    return backlog_ / 1000.0;
+}
+
+int SdlFixedStep::perStep(int perSec) const
+{
+    Sint64 cur = numSteps_ % stepsPerSec_;
+    return perSec * (cur + 1) / stepsPerSec_ - perSec * cur / stepsPerSec_;
+}
+
+SdlRecolor::SdlRecolor(const std::vector<Uint32> &baseColors,
+                       const SDL_PixelFormat *fmt)
+    : rgbMask_(fmt->Rmask | fmt->Gmask | fmt->Bmask),
+    base_(),
+    palettes_(),
+    hashMult_(0),
+    hashShift_(0),
+    hashTable_(),
+    rangeLo_(0),
+    rangeHi_(0)
+{
+    assert(!baseColors.empty() && baseColors.size() < 128);
+    for (auto c : baseColors) {
+        base_.push_back(c & rgbMask_);
+    }
+
+    // Find a multiplier that sends every base color to a different slot.
+    // With a table at least 4x the number of colors, one turns up after a
+    // few tries.
+    int bits = 2;
+    while ((1u << bits) < base_.size() * 4) {
+        ++bits;
+    }
+    for (; bits <= 16 && hashMult_ == 0; ++bits) {
+        hashShift_ = 32 - bits;
+        for (Uint32 mult = 2654435761u, tries = 0; tries < 1000;
+             mult += 2, ++tries)
+        {
+            hashTable_.assign(1u << bits, -1);
+            bool collision = false;
+            for (auto i = 0u; i < base_.size() && !collision; ++i) {
+                auto slot = (base_[i] * mult) >> hashShift_;
+                collision = (hashTable_[slot] != -1);
+                hashTable_[slot] = i;
+            }
+            if (!collision) {
+                hashMult_ = mult;
+                break;
+            }
+        }
+    }
+    assert(hashMult_ != 0);
+
+    // Compute the range of each byte.  Bytes outside the RGB mask hold alpha;
+    // there the range excludes zero so we also skip invisible pixels.
+    for (int shift = 0; shift < 32; shift += 8) {
+        Uint32 lo = 0xFF;
+        Uint32 hi = 0;
+        if (((rgbMask_ >> shift) & 0xFF) != 0) {
+            for (auto c : base_) {
+                lo = std::min(lo, (c >> shift) & 0xFF);
+                hi = std::max(hi, (c >> shift) & 0xFF);
+            }
+        }
+        else {
+            lo = 1;
+            hi = 0xFF;
+        }
+        rangeLo_ |= lo << shift;
+        rangeHi_ |= hi << shift;
+    }
+}
+
+int SdlRecolor::addPalette(const std::vector<Uint32> &colors)
+{
+    assert(colors.size() == base_.size());
+    std::vector<Uint32> palette;
+    for (auto c : colors) {
+        palette.push_back(c & rgbMask_);
+    }
+    palettes_.push_back(std::move(palette));
+    return palettes_.size() - 1;
+}
+
+// source: Battle for Wesnoth, recolor_image() in sdl_utils.cpp.
+void SdlRecolor::apply(SdlSurface &img, int palette) const
+{
+    assert(palette >= 0 && palette < static_cast<int>(palettes_.size()));
+    assert(img->format->BytesPerPixel == 4);
+
+    SdlLock(img, [&] {
+        auto pixels = static_cast<Uint8 *>(img->pixels);
+        for (int y = 0; y < img->h; ++y) {
+            auto row = reinterpret_cast<Uint32 *>(pixels + y * img->pitch);
+            applyRow(row, img->w, img->format->Amask, palettes_[palette]);
+        }
+    });
+}
+
+int SdlRecolor::lookup(Uint32 rgb) const
+{
+    int i = hashTable_[(rgb * hashMult_) >> hashShift_];
+    if (i >= 0 && base_[i] == rgb) {
+        return i;
+    }
+    return -1;
+}
+
+void SdlRecolor::applyRow(Uint32 *row, int len, Uint32 alphaMask,
+                          const std::vector<Uint32> &colors) const
+{
+    auto recolor = [&] (Uint32 &pixel) {
+        auto i = lookup(pixel & rgbMask_);
+        if (i >= 0) {
+            pixel = (pixel & alphaMask) | colors[i];
+        }
+    };
+
+    int x = 0;
+#ifdef __SSE2__
+    // Test four pixels at a time against the byte ranges.  Most pixels in a
+    // sprite are transparent or nowhere near a base color, so usually we can
+    // skip all four.
+    const __m128i lo = _mm_set1_epi32(rangeLo_);
+    const __m128i hi = _mm_set1_epi32(rangeHi_);
+    const __m128i allBytes = _mm_set1_epi32(-1);
+    for (; x + 4 <= len; x += 4) {
+        auto p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        auto aboveLo = _mm_cmpeq_epi8(_mm_max_epu8(p, lo), p);
+        auto belowHi = _mm_cmpeq_epi8(_mm_min_epu8(p, hi), p);
+        auto inRange = _mm_cmpeq_epi32(_mm_and_si128(aboveLo, belowHi),
+                                       allBytes);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(inRange));
+        for (int i = 0; mask != 0; ++i, mask >>= 1) {
+            if (mask & 1) {
+                recolor(row[x + i]);
+            }
+        }
+    }
+#endif
+
+    // Leftover pixels, or everything if we don't have SSE2.
+    for (; x < len; ++x) {
+        bool inRange = true;
+        for (int shift = 0; shift < 32 && inRange; shift += 8) {
+            auto b = (row[x] >> shift) & 0xFF;
+            inRange = (b >= ((rangeLo_ >> shift) & 0xFF) &&
+                       b <= ((rangeHi_ >> shift) & 0xFF));
+        }
+        if (inRange) {
+            recolor(row[x]);
+        }
+    }
+}
+
 SdlSurface make_surface(SDL_Surface *surf)
 {
     return SdlSurface(surf, SDL_FreeSurface);
 }
 
-// source: SDL_CreateRGBSurface documentation.
 SdlSurface sdlCreateSurface(Sint16 width, Sint16 height)
 {
     // This can only be called after SDL_SetVideoMode()
     assert(screen != nullptr);
 
-    SDL_Surface *surf;
-    Uint32 rmask, gmask, bmask, amask;
-
-    // SDL interprets each pixel as a 32-bit number, so our masks must depend
-    // on the endianness (byte order) of the machine.
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    rmask = 0xff000000;
-    gmask = 0x00ff0000;
-    bmask = 0x0000ff00;
-    amask = 0x000000ff;
-#else
-    rmask = 0x000000ff;
-    gmask = 0x0000ff00;
-    bmask = 0x00ff0000;
-    amask = 0xff000000;
-#endif
-
-    surf = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
-                                rmask, gmask, bmask, amask);
+    auto surf = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+                                     rmask, gmask, bmask, amask);
     if (surf == nullptr) {
         std::cerr << "Error creating new surface: " << SDL_GetError() << '\n';
     }
@@ -213,32 +792,104 @@ SdlSurface sdlDisplayFormat(const SdlSurface &src)
     return surf;
 }
 
-SdlSurface sdlFlipH(const SdlSurface &src)
+SdlSurface sdlDisplayFormat(const SdlPixelBuffer &buf)
 {
-    auto surf = deepCopy(src);
-    if (!surf) {
+    assert(screen != nullptr);
+    if (buf.pixels.empty()) {
+        return nullptr;
+    }
+    assert(buf.pixels.size() == static_cast<size_t>(buf.w * buf.h));
+
+    // Wrap the buffer without copying it.  The display format conversion
+    // makes the copy.
+    auto data = const_cast<Uint32 *>(buf.pixels.data());
+    auto wrapper = make_surface(SDL_CreateRGBSurfaceFrom(data, buf.w, buf.h,
+        32, buf.w * 4, rmask, gmask, bmask, amask));
+    if (!wrapper) {
+        std::cerr << "Error wrapping pixel buffer: " << SDL_GetError() << '\n';
         return nullptr;
     }
+    return sdlDisplayFormat(wrapper);
+}
 
-    SdlLock(surf, [&] {
-        flipH(surf, 0, surf->w);
+SdlPixelBuffer sdlDecodeImage(const char *filename)
+{
+    auto entry = findInBundle(filename, BundleType::IMAGE);
+    if (entry) {
+        SdlPixelBuffer buf(entry->width, entry->height);
+        memcpy(buf.pixels.data(), bundleData->data() + entry->dataOffset,
+               entry->dataSize);
+        return buf;
+    }
+
+    auto img = make_surface(IMG_Load(filename));
+    if (!img) {
+        std::cerr << "Error loading image " << filename
+            << "\n    " << IMG_GetError() << '\n';
+        return {0, 0};
+    }
+
+    // Let SDL convert whatever format the file was in.
+    auto layout = make_surface(SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32,
+                                                    rmask, gmask, bmask, amask));
+    SdlSurface rgba;
+    if (layout) {
+        rgba = make_surface(SDL_ConvertSurface(img.get(), layout->format,
+                                               SDL_SWSURFACE));
+    }
+    if (!rgba) {
+        std::cerr << "Error converting image " << filename
+            << "\n    " << SDL_GetError() << '\n';
+        return {0, 0};
+    }
+
+    SdlPixelBuffer buf(rgba->w, rgba->h);
+    SdlLock(rgba, [&] {
+        auto src = static_cast<const Uint8 *>(rgba->pixels);
+        for (auto y = 0; y < rgba->h; ++y) {
+            memcpy(&buf.pixels[y * buf.w], src + y * rgba->pitch, buf.w * 4);
+        }
     });
-    return surf;
+    return buf;
+}
+
+Uint32 sdlPixelRGB(Uint8 r, Uint8 g, Uint8 b)
+{
+    // Shift as unsigned so a channel shifted into the top byte doesn't
+    // overflow an int.
+    return (Uint32(r) << rshift) | (Uint32(g) << gshift) |
+        (Uint32(b) << bshift) | (0xFFu << ashift);
+}
+
+SdlSurface sdlCopySurface(const SdlSurface &src)
+{
+    auto surf = SDL_ConvertSurface(src.get(), src->format, src->flags);
+    if (!surf) {
+        std::cerr << "Error copying surface: " << SDL_GetError() << '\n';
+        return nullptr;
+    }
+    return make_surface(surf);
+}
+
+SdlSurface sdlFlipH(const SdlSurface &src)
+{
+    return sdlFlipSheetH(src, 1);
 }
 
 SdlSurface sdlFlipSheetH(const SdlSurface &src, int numFrames)
 {
-    auto surf = deepCopy(src);
+    auto surf = blankSurface(src, src->w, src->h);
     if (!surf) {
         return nullptr;
     }
 
-    auto frameWidth = surf->w / numFrames;
-    SdlLock(surf, [&] {
-        for (auto x = 0; x < surf->w; x += frameWidth) {
-            flipH(surf, x, frameWidth);
-        }
-    });
+    Sint16 frameWidth = src->w / numFrames;
+    for (auto f = 0; f < numFrames; ++f) {
+        SDL_Rect frame = {static_cast<Sint16>(f * frameWidth), 0,
+                          static_cast<Uint16>(frameWidth),
+                          static_cast<Uint16>(src->h)};
+        mirrorRegion(src, frame, surf, frame.x);
+    }
     return surf;
 }
 
@@ -259,25 +910,198 @@ void sdlBlit(const SdlSurface &surf, const Point &pos)
 
 void sdlBlitFrame(const SdlSurface &surf, int frame, int numFrames,
                   Sint16 px, Sint16 py)
+{
+    SDL_Rect whole = {0, 0, static_cast<Uint16>(surf->w),
+                      static_cast<Uint16>(surf->h)};
+    sdlBlitFrame(surf, whole, frame, numFrames, px, py);
+}
+
+void sdlBlitFrame(const SdlSurface &surf, int frame, int numFrames,
+                  const Point &pos)
+{
+    sdlBlitFrame(surf, frame, numFrames, pos.first, pos.second);
+}
+
+void sdlBlit(const SdlSurface &surf, const SDL_Rect &region,
+             Sint16 px, Sint16 py)
 {
     assert(screen != nullptr);
-    Sint16 frameWidth = surf->w / numFrames;
-    SDL_Rect src;
-    src.x = frame * frameWidth;
-    src.y = 0;
-    src.w = frameWidth;
-    src.h = surf->h;
-    auto dest = SDL_Rect{px, py, 0, 0};
+    auto src = region;
+    SDL_Rect dest = {px, py, 0, 0};
     if (SDL_BlitSurface(surf.get(), &src, screen, &dest) < 0) {
         std::cerr << "Warning: error drawing to screen: " << SDL_GetError()
             << '\n';
     }
 }
 
-void sdlBlitFrame(const SdlSurface &surf, int frame, int numFrames,
-                  const Point &pos)
+void sdlBlitFrame(const SdlSurface &surf, const SDL_Rect &region,
+                  int frame, int numFrames, Sint16 px, Sint16 py)
 {
-    sdlBlitFrame(surf, frame, numFrames, pos.first, pos.second);
+    Sint16 frameWidth = region.w / numFrames;
+    SDL_Rect src;
+    src.x = region.x + frame * frameWidth;
+    src.y = region.y;
+    src.w = frameWidth;
+    src.h = region.h;
+    sdlBlit(surf, src, px, py);
+}
+
+void sdlBlitMirrored(const SdlSurface &surf, Sint16 px, Sint16 py)
+{
+    SDL_Rect whole = {0, 0, static_cast<Uint16>(surf->w),
+                      static_cast<Uint16>(surf->h)};
+    sdlBlitMirrored(surf, whole, px, py);
+}
+
+void sdlBlitMirrored(const SdlSurface &surf, const Point &pos)
+{
+    sdlBlitMirrored(surf, pos.first, pos.second);
+}
+
+void sdlBlitFrameMirrored(const SdlSurface &surf, int frame, int numFrames,
+                          Sint16 px, Sint16 py)
+{
+    Sint16 frameWidth = surf->w / numFrames;
+    SDL_Rect src = {static_cast<Sint16>(frame * frameWidth), 0,
+                    static_cast<Uint16>(frameWidth),
+                    static_cast<Uint16>(surf->h)};
+    sdlBlitMirrored(surf, src, px, py);
+}
+
+void sdlBlitFrameMirrored(const SdlSurface &surf, int frame, int numFrames,
+                          const Point &pos)
+{
+    sdlBlitFrameMirrored(surf, frame, numFrames, pos.first, pos.second);
+}
+
+void sdlBlitMirrored(const SdlSurface &surf, const SDL_Rect &region,
+                     Sint16 px, Sint16 py)
+{
+    // Mirror just this region into a scratch surface and blit that.  SDL does
+    // the clipping and alpha blending, and we never keep a flipped copy of the
+    // whole image around.
+    if (!mirrorScratch || !sameFormat(mirrorScratch, surf) ||
+        mirrorScratch->w < region.w || mirrorScratch->h < region.h)
+    {
+        Sint16 width = region.w;
+        Sint16 height = region.h;
+        if (mirrorScratch && sameFormat(mirrorScratch, surf)) {
+            width = std::max<Sint16>(width, mirrorScratch->w);
+            height = std::max<Sint16>(height, mirrorScratch->h);
+        }
+        mirrorScratch = blankSurface(surf, width, height);
+        if (!mirrorScratch) {
+            return;
+        }
+    }
+
+    mirrorRegion(surf, region, mirrorScratch, 0);
+    SDL_Rect src = {0, 0, region.w, region.h};
+    sdlBlit(mirrorScratch, src, px, py);
+}
+
+const SdlSpanMask & sdlHexMask()
+{
+    // Flat-topped hex.  The top edge covers the middle half of the first row
+    // and each side steps out one pixel every two rows to the midline.
+    static const SdlSpanMask mask = [] {
+        SdlSpanMask m;
+        m.w = pHexSize;
+        for (Sint16 y = 0; y < pHexSize; ++y) {
+            Sint16 fromEdge = std::min<Sint16>(y, pHexSize - 1 - y);
+            Sint16 x = std::max(0, pHexSize / 4 - (fromEdge + 1) / 2);
+            m.rows.push_back(SdlSpan{x, static_cast<Sint16>(pHexSize - 2 * x)});
+        }
+        return m;
+    }();
+    return mask;
+}
+
+const SdlSpanMask & sdlHexEdgeMask(Dir d)
+{
+    static const std::vector<SdlSpanMask> edges = [] {
+        const auto &hex = sdlHexMask();
+        const Sint16 thickness = 2;
+        const Sint16 mid = pHexSize / 2;
+
+        std::vector<SdlSpanMask> masks(6, SdlSpanMask{
+            std::vector<SdlSpan>(pHexSize, SdlSpan{0, 0}), pHexSize});
+        for (Sint16 y = 0; y < pHexSize; ++y) {
+            auto span = hex.rows[y];
+            auto left = SdlSpan{span.x, thickness};
+            auto right = SdlSpan{static_cast<Sint16>(span.x + span.len -
+                                                     thickness), thickness};
+            if (y < thickness) {
+                masks[static_cast<int>(Dir::N)].rows[y] = span;
+            }
+            if (y >= pHexSize - thickness) {
+                masks[static_cast<int>(Dir::S)].rows[y] = span;
+            }
+            if (y < mid) {
+                masks[static_cast<int>(Dir::NW)].rows[y] = left;
+                masks[static_cast<int>(Dir::NE)].rows[y] = right;
+            }
+            else {
+                masks[static_cast<int>(Dir::SW)].rows[y] = left;
+                masks[static_cast<int>(Dir::SE)].rows[y] = right;
+            }
+        }
+        return masks;
+    }();
+    return edges[static_cast<int>(d)];
+}
+
+void sdlTintSpans(const SdlSpanMask &mask, Sint16 px, Sint16 py,
+                  const SDL_Color &color, Uint8 alpha)
+{
+    assert(screen != nullptr);
+    if (alpha == 0) {
+        return;
+    }
+
+    auto fmt = screen->format;
+    const int bpp = fmt->BytesPerPixel;
+    auto rgb = SDL_MapRGB(fmt, color.r, color.g, color.b);
+    auto rgbMask = fmt->Rmask | fmt->Gmask | fmt->Bmask;
+    std::array<Uint16, 4> weights;
+    for (int i = 0; i < 4; ++i) {
+        weights[i] = ((rgbMask >> (i * 8)) & 0xFF) ? alpha : 0;
+    }
+
+    const auto &clip = screen->clip_rect;
+    auto tint = [&] {
+        auto pixels = static_cast<Uint8 *>(screen->pixels);
+        for (unsigned i = 0; i < mask.rows.size(); ++i) {
+            int y = py + i;
+            if (y < clip.y || y >= clip.y + clip.h) continue;
+
+            const auto &span = mask.rows[i];
+            int x1 = std::max<int>(px + span.x, clip.x);
+            int x2 = std::min<int>(px + span.x + span.len, clip.x + clip.w);
+            if (x1 >= x2) continue;
+
+            auto row = pixels + y * screen->pitch;
+            if (bpp == 4) {
+                tintRow(reinterpret_cast<Uint32 *>(row) + x1, x2 - x1, rgb,
+                        weights);
+            }
+            else {
+                tintRowAnyDepth(row + x1 * bpp, x2 - x1, fmt, color, alpha);
+            }
+        }
+    };
+
+    if (SDL_MUSTLOCK(screen)) {
+        if (SDL_LockSurface(screen) < 0) {
+            std::cerr << "Error locking screen: " << SDL_GetError() << '\n';
+            return;
+        }
+        tint();
+        SDL_UnlockSurface(screen);
+    }
+    else {
+        tint();
+    }
 }
 
 void sdlClear(SDL_Rect region)
@@ -289,8 +1113,80 @@ void sdlClear(SDL_Rect region)
     }
 }
 
+bool sdlLoadBundle(const char *filename)
+{
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+
+    // Read the whole thing at once.
+    auto size = static_cast<size_t>(in.tellg());
+    auto data = std::make_shared<std::vector<char>>(size);
+    in.seekg(0);
+    in.read(data->data(), size);
+
+    BundleHeader header;
+    if (!in || size < sizeof(header)) {
+        std::cerr << "Error reading asset bundle " << filename << '\n';
+        return false;
+    }
+    memcpy(&header, data->data(), sizeof(header));
+    if (memcmp(header.magic, bundleMagic, sizeof(bundleMagic)) != 0 ||
+        header.version != bundleVersion ||
+        header.numEntries > (size - sizeof(header)) / sizeof(BundleEntry))
+    {
+        std::cerr << "Error: " << filename << " is not a valid asset bundle\n";
+        return false;
+    }
+
+    // Sounds are only usable if the mixer is set up the same way it was when
+    // the bundle was built.
+    int freq = 0;
+    Uint16 format = 0;
+    int channels = 0;
+    bool soundsOk = Mix_QuerySpec(&freq, &format, &channels) != 0 &&
+        freq == header.audioFreq && format == header.audioFormat &&
+        channels == header.audioChannels;
+
+    std::unordered_map<std::string, BundleEntry> entries;
+    for (auto i = 0u; i < header.numEntries; ++i) {
+        BundleEntry e;
+        memcpy(&e, data->data() + sizeof(header) + i * sizeof(BundleEntry),
+               sizeof(e));
+        // Written so that a corrupt entry can't make the arithmetic wrap.
+        if (e.nameOffset > size || e.nameLen > size - e.nameOffset ||
+            e.dataOffset > size || e.dataSize > size - e.dataOffset ||
+            (e.type == BundleType::IMAGE &&
+             e.dataSize != Uint64(e.width) * e.height * 4))
+        {
+            std::cerr << "Error: asset bundle " << filename << " is corrupt\n";
+            return false;
+        }
+        if (e.type == BundleType::SOUND && !soundsOk) continue;
+
+        entries.emplace(std::string(data->data() + e.nameOffset, e.nameLen), e);
+    }
+
+    bundleData = data;
+    bundleEntries = std::move(entries);
+    return true;
+}
+
 SdlSurface sdlLoadImage(const char *filename)
 {
+    auto entry = findInBundle(filename, BundleType::IMAGE);
+    if (entry) {
+        auto pixels = bundleData->data() + entry->dataOffset;
+        auto img = make_surface(SDL_CreateRGBSurfaceFrom(pixels, entry->width,
+            entry->height, 32, entry->width * 4, rmask, gmask, bmask, amask));
+        if (img) {
+            return sdlDisplayFormat(img);
+        }
+        std::cerr << "Warning: error reading " << filename
+            << " from asset bundle: " << SDL_GetError() << '\n';
+    }
+
     auto img = make_surface(IMG_Load(filename));
     if (!img) {
         std::cerr << "Error loading image " << filename
@@ -302,7 +1198,7 @@ SdlSurface sdlLoadImage(const char *filename)
 
 SdlFont sdlLoadFont(const char *filename, int ptSize)
 {
-    SdlFont font(TTF_OpenFont(filename, ptSize), TTF_CloseFont);
+    SdlFont font(TTF_OpenFont(filename, ptSize), closeFont);
     if (!font) {
         std::cerr << "Error loading font " << filename << " size " << ptSize
             << "\n    " << TTF_GetError() << '\n';
@@ -327,6 +1223,20 @@ SdlMusic sdlLoadMusic(const std::string &filename)
 
 SdlSound sdlLoadSound(const char *filename)
 {
+    auto entry = findInBundle(filename, BundleType::SOUND);
+    if (entry) {
+        auto data = bundleData;
+        auto samples = reinterpret_cast<Uint8 *>(data->data() +
+                                                 entry->dataOffset);
+        SdlSound sound{Mix_QuickLoad_RAW(samples, entry->dataSize),
+                       [data] (Mix_Chunk *c) { Mix_FreeChunk(c); }};
+        if (sound) {
+            return sound;
+        }
+        std::cerr << "Warning: error reading " << filename
+            << " from asset bundle: " << Mix_GetError() << '\n';
+    }
+
     SdlSound sound{Mix_LoadWAV(filename), Mix_FreeChunk};
     if (!sound) {
         std::cerr << "Error loading sound " << filename << "\n    "
@@ -431,25 +1341,30 @@ SDL_Rect sdlGetBounds(const SdlSurface &surf, Sint16 x, Sint16 y)
 void sdlDrawText(const SdlFont &font, const char *txt, SDL_Rect pos,
                  const SDL_Color &color)
 {
-    auto lines = wordWrap(font, txt, pos.w);
+    TextKey key{font.get(), txt, pos.w,
+                Uint32(color.r << 16 | color.g << 8 | color.b)};
+    SdlSurface img;
+    auto iter = textCache.find(key);
+    if (iter != std::end(textCache)) {
+        img = iter->second;
+    }
+    else {
+        img = renderText(font.get(), txt, pos.w, color);
+        textCache.emplace(key, img);
+        textCacheOrder.push_back(key);
+        if (textCacheOrder.size() > textCacheSize) {
+            textCache.erase(textCacheOrder.front());
+            textCacheOrder.pop_front();
+        }
+    }
 
     sdlClear(pos);
+    if (!img) {
+        return;
+    }
     SdlSetClipRect(pos, [&]
     {
-        auto yPos = pos.y;
-        for (const auto &str : lines) {
-            auto textImg = make_surface(TTF_RenderText_Blended(font.get(),
-                                                               str.c_str(),
-                                                               color));
-            if (textImg == nullptr) {
-                std::cerr << "Warning: error rendering blended text: " <<
-                    TTF_GetError();
-                return;
-            }
-
-            sdlBlit(textImg, pos.x, yPos);
-            yPos += TTF_FontLineSkip(font.get());
-        }
+        sdlBlit(img, pos.x, pos.y);
     });
 }
 
@@ -18,10 +18,12 @@
 #include "SDL_mixer.h"
 #include "SDL_ttf.h"
 #include "hex_utils.h"
+#include <array>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 using SdlSurface = std::shared_ptr<SDL_Surface>;
 using SdlFont = std::unique_ptr<TTF_Font, void(*)(TTF_Font *)>;
@@ -46,7 +48,40 @@ SdlSurface sdlCreateSurface(Sint16 width, Sint16 height);
 // failure.
 SdlSurface sdlDisplayFormat(const SdlSurface &src);
 
-// Flip a surface or sprite sheet.  Creates a new surface.
+// Image data built off the main thread.  Worker threads can't touch the
+// display, so they fill one of these instead of a surface.  Pixels use the
+// same RGBA layout as sdlCreateSurface().
+struct SdlPixelBuffer
+{
+    Sint16 w;
+    Sint16 h;
+    std::vector<Uint32> pixels;
+
+    SdlPixelBuffer(Sint16 width, Sint16 height)
+        : w(width), h(height), pixels(w * h)
+    {
+    }
+};
+
+// Return an opaque pixel in the layout used by SdlPixelBuffer.  Safe to call
+// from any thread.
+Uint32 sdlPixelRGB(Uint8 r, Uint8 g, Uint8 b);
+
+// Copy a pixel buffer into a new surface in the screen format.  Main thread
+// only.  Return a null surface on failure or if the buffer is empty.
+SdlSurface sdlDisplayFormat(const SdlPixelBuffer &buf);
+
+// Decode an image file (or asset bundle entry) into a pixel buffer.  Safe to
+// call from any thread.  Return an empty buffer on failure.
+SdlPixelBuffer sdlDecodeImage(const char *filename);
+
+// Return a copy of a surface in the same format.  Return a null surface on
+// failure.
+SdlSurface sdlCopySurface(const SdlSurface &src);
+
+// Flip a surface or sprite sheet.  Creates a new surface.  Prefer the
+// mirrored blits below unless the flipped image is drawn many times a frame.
+// Images must be 32 bits per pixel.
 SdlSurface sdlFlipH(const SdlSurface &src);
 SdlSurface sdlFlipSheetH(const SdlSurface &src, int numFrames);
 
@@ -62,6 +97,52 @@ void sdlBlitFrame(const SdlSurface &surf, int frame, int numFrames,
 void sdlBlitFrame(const SdlSurface &surf, int frame, int numFrames,
                   const Point &pos);
 
+// Same as above, but draw from a region of a larger surface such as a texture
+// atlas.  The region takes the place of the full surface.
+void sdlBlit(const SdlSurface &surf, const SDL_Rect &region,
+             Sint16 px, Sint16 py);
+void sdlBlitFrame(const SdlSurface &surf, const SDL_Rect &region,
+                  int frame, int numFrames, Sint16 px, Sint16 py);
+
+// Draw an image, sprite sheet frame, or region mirrored left-to-right.  The
+// flip happens during the draw, so there's no need to keep a flipped copy of
+// sprites that can face either way.  Images must be 32 bits per pixel.
+void sdlBlitMirrored(const SdlSurface &surf, Sint16 px, Sint16 py);
+void sdlBlitMirrored(const SdlSurface &surf, const Point &pos);
+void sdlBlitFrameMirrored(const SdlSurface &surf, int frame, int numFrames,
+                          Sint16 px, Sint16 py);
+void sdlBlitFrameMirrored(const SdlSurface &surf, int frame, int numFrames,
+                          const Point &pos);
+void sdlBlitMirrored(const SdlSurface &surf, const SDL_Rect &region,
+                     Sint16 px, Sint16 py);
+
+// A shape stored as one run of pixels per row, such as a hexagon.
+struct SdlSpan
+{
+    Sint16 x;
+    Sint16 len;
+};
+struct SdlSpanMask
+{
+    std::vector<SdlSpan> rows;  // starting from the top
+    Sint16 w;
+};
+
+// The shape of one map hex, pHexSize pixels square.  This matches the opaque
+// pixels of the hex tile images.
+const SdlSpanMask & sdlHexMask();
+
+// One edge of the hex mask, two pixels thick, for drawing outlines.
+const SdlSpanMask & sdlHexEdgeMask(Dir d);
+
+// Blend a color into just the screen pixels covered by a mask, with (px,py)
+// as its upper-left corner.  Use it to darken or highlight hexes for far less
+// than the cost of alpha-blitting an image of the same shape.  Respects the
+// screen's clip rect.  Fastest on a 32-bit screen; other depths blend one
+// pixel at a time.
+void sdlTintSpans(const SdlSpanMask &mask, Sint16 px, Sint16 py,
+                  const SDL_Color &color, Uint8 alpha);
+
 // Clear the given region of the screen.
 void sdlClear(SDL_Rect region);
 
@@ -114,6 +195,143 @@ struct SdlLock
     }
 };
 
+// Pace a main loop at a target frame rate instead of spinning on
+// SDL_Delay(1).  Also keeps a rolling history of recent frame times.
+//
+// Typical usage:
+//     SdlFrameClock clock(60);
+//     while (!isDone) {
+//         auto elapsed_ms = clock.tick();
+//         while (clock.pollEvent(event, !animating)) { ... }
+//         ...draw...
+//         clock.wait();
+//     }
+class SdlFrameClock
+{
+public:
+    explicit SdlFrameClock(int targetFps = 60);
+
+    // Mark the start of a new frame.  Return the time elapsed since the
+    // previous frame, not counting any time spent idle in pollEvent().
+    Uint32 tick();
+
+    // Like SDL_PollEvent.  If the caller has nothing to animate, the first
+    // call of each frame blocks until an event arrives so we don't burn CPU.
+    bool pollEvent(SDL_Event &event, bool idle);
+
+    // Sleep until the next frame is due.  Returns immediately if we're
+    // already running behind.
+    void wait();
+
+    // Frame time in ms at the given percentile [0,100] over the most recent
+    // frames.  Return 0 if no frames have been recorded yet.
+    Uint32 percentile(double pct) const;
+
+    // Print p50/p95/p99 frame times.
+    void printStats(std::ostream &os) const;
+
+private:
+    static const int historySize_ = 256;
+
+    Uint32 period_ms_;
+    Uint32 frameStart_ms_;
+    Uint32 deadline_ms_;
+    bool waitedThisFrame_;
+    std::array<Uint32, historySize_> history_;  // ring buffer
+    int numFrames_;
+    int next_;
+};
+
+// Run a simulation in fixed time steps no matter how fast frames are drawn,
+// so it behaves the same under load.  Feed it the time from the frame clock
+// once per frame, run however many steps that covers, then draw.  Anything
+// that moves can be drawn partway between its last two steps using alpha().
+//
+// Typical usage:
+//     SdlFrameClock clock;
+//     SdlFixedStep sim(60);
+//     while (!isDone) {
+//         sim.advance(clock.tick());
+//         ...handle events...
+//         while (sim.step()) {
+//             ...update as of sim.time_ms()...
+//         }
+//         ...draw using sim.alpha()...
+//         clock.wait();
+//     }
+class SdlFixedStep
+{
+public:
+    // If a frame takes so long that it would need more than 'maxSteps' to
+    // catch up, the extra time is dropped and the simulation slows down
+    // rather than falling further behind.
+    explicit SdlFixedStep(int stepsPerSec = 60, int maxSteps = 5);
+
+    void advance(Uint32 elapsed_ms);
+
+    // Return true if there's another step to run this frame.
+    bool step();
+
+    // Simulated time as of the most recent step.
+    Uint32 time_ms() const;
+
+    // How far we are toward the next step [0,1).
+    double alpha() const;
+
+    // The part of a per-second rate that falls in the most recent step.
+    // These add up to exactly 'perSec' over each second of steps.
+    int perStep(int perSec) const;
+
+private:
+    int stepsPerSec_;
+    Uint32 maxBacklog_;
+    Uint32 backlog_;  // in units of 1/stepsPerSec ms
+    Uint32 numSteps_;
+};
+
+// Swap one set of colors in an image for another, such as the Battle for
+// Wesnoth team colors.  Each palette must be the same size as the set of base
+// colors.  Colors are compared on RGB only and alpha is left alone.  All
+// colors must be in the given pixel format (usually the screen's), and images
+// must be 32 bits per pixel.
+class SdlRecolor
+{
+public:
+    SdlRecolor(const std::vector<Uint32> &baseColors,
+               const SDL_PixelFormat *fmt);
+
+    // Add a replacement palette.  Return its index for use with apply().
+    int addPalette(const std::vector<Uint32> &colors);
+
+    // Replace the base colors in an image with those from the given palette.
+    void apply(SdlSurface &img, int palette) const;
+
+private:
+    // Return the position of the given color in the base set, or -1.
+    int lookup(Uint32 rgb) const;
+    void applyRow(Uint32 *row, int len, Uint32 alphaMask,
+                  const std::vector<Uint32> &colors) const;
+
+    Uint32 rgbMask_;
+    std::vector<Uint32> base_;
+    std::vector<std::vector<Uint32>> palettes_;
+
+    // Perfect hash of the base colors: slot = (rgb * hashMult_) >> hashShift_.
+    Uint32 hashMult_;
+    int hashShift_;
+    std::vector<Sint8> hashTable_;  // index into base_, -1 if empty
+
+    // Smallest and largest value of each byte across the base colors.  Any
+    // pixel outside this range can't be a base color.
+    Uint32 rangeLo_;
+    Uint32 rangeHi_;
+};
+
+// Use the images and sounds in an asset bundle built by mkbundle.  After this,
+// sdlLoadImage() and sdlLoadSound() check the bundle before going to disk.
+// Return false if the bundle doesn't exist or can't be used.
+bool sdlLoadBundle(const char *filename);
+
 // Load a resource from disk.  Returns null on failure.
 SdlSurface sdlLoadImage(const char *filename);
 SdlFont sdlLoadFont(const char *filename, int ptSize);
@@ -137,7 +355,9 @@ Dir8 nearEdge(Sint16 x, Sint16 y, const SDL_Rect &rect);
 // Return the bounding box for the given image.
 SDL_Rect sdlGetBounds(const SdlSurface &surf, Sint16 x, Sint16 y);
 
-// Draw text to the screen.
+// Draw text to the screen, word wrapped to fit the width of pos.  Glyphs and
+// finished blocks of text are cached, so redrawing the same text is just a
+// blit.  Fonts must come from sdlLoadFont().
 void sdlDrawText(const SdlFont &font, const char *txt, SDL_Rect pos,
                  const SDL_Color &color);
 void sdlDrawText(const SdlFont &font, const std::string &txt, SDL_Rect pos,
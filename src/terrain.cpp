@@ -33,6 +33,17 @@ int getEdge(int terrainFrom, int terrainTo)
     return -1;
 }
 
+int getMoveCost(int terrain)
+{
+    // Indexed by Terrain.
+    static const int moveCost[] = {1, 1, 2, 3, 3, 2};
+    static_assert(sizeof(moveCost) / sizeof(moveCost[0]) == NUM_TERRAINS,
+                  "need a move cost for every terrain");
+
+    assert(terrain >= 0 && terrain < NUM_TERRAINS);
+    return moveCost[terrain];
+}
+
 std::vector<int> graphTerrain(const AdjacencyList &graph)
 {
     auto size = graph.size();
@@ -28,4 +28,9 @@ std::vector<int> graphTerrain(const AdjacencyList &graph);
 // should be drawn.
 int getEdge(int terrainFrom, int terrainTo);
 
+// Return the cost of moving onto a hex of the given terrain.  Costs are small
+// positive integers, never more than maxMoveCost.
+int getMoveCost(int terrain);
+const int maxMoveCost = 3;
+
 #endif
@@ -32,3 +32,12 @@ BOOST_AUTO_TEST_CASE(Edges)
         }
     }
 }
+
+// The pathfinder sizes its bucket queue by the largest move cost.
+BOOST_AUTO_TEST_CASE(MoveCosts)
+{
+    for (int i = 0; i < NUM_TERRAINS; ++i) {
+        BOOST_CHECK_GE(getMoveCost(i), 1);
+        BOOST_CHECK_LE(getMoveCost(i), maxMoveCost);
+    }
+}
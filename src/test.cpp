@@ -15,6 +15,7 @@
 
 #include "HexGrid.h"
 #include "algo.h"
+#include "hex_cube.h"
 #include "hex_utils.h"
 
 BOOST_AUTO_TEST_CASE(Distance)
@@ -23,6 +24,12 @@ BOOST_AUTO_TEST_CASE(Distance)
     BOOST_CHECK_EQUAL(hexDist({4, 4}, {3, 3}), 1);
     BOOST_CHECK_EQUAL(hexDist({1, 1}, {3, 3}), 3);
     BOOST_CHECK_EQUAL(hexDist({7, 7}, {5, 5}), 3);
+
+    // The terrain grid extends past the main grid to (-1,-1).
+    BOOST_CHECK_EQUAL(hexDist({-1, 0}, {0, 0}), 1);
+    BOOST_CHECK_EQUAL(hexDist({-1, 0}, {0, 1}), 1);
+    BOOST_CHECK_EQUAL(hexDist({-1, -1}, {1, -1}), 2);
+    BOOST_CHECK_EQUAL(hexDist({-3, 2}, {-3, 2}), 0);
 }
 
 BOOST_AUTO_TEST_CASE(Array_Index_To_Hex)
@@ -91,3 +98,74 @@ BOOST_AUTO_TEST_CASE(Hex_Get_Neighbor)
                           str(grid.hexFromAry(grid.aryGetNeighbor(a2, d))));
     }
 }
+
+BOOST_AUTO_TEST_CASE(Cube_Coordinates)
+{
+    for (Sint16 hx = -3; hx < 4; ++hx) {
+        for (Sint16 hy = -3; hy < 4; ++hy) {
+            Point hex{hx, hy};
+            BOOST_CHECK_EQUAL(str(hexFromCube(cubeFromHex(hex))), str(hex));
+            for (auto d : Dir()) {
+                BOOST_CHECK_EQUAL(hexDist(hex, adjacent(hex, d)), 1);
+            }
+        }
+    }
+}
+
+// The batch versions must agree with doing one hex at a time.  Use an odd
+// size so vectorized loops have leftovers.
+BOOST_AUTO_TEST_CASE(Batch_Kernels)
+{
+    std::vector<Sint16> hx, hy;
+    for (Sint16 x = -2; x < 9; ++x) {
+        for (Sint16 y = -2; y < 7; ++y) {
+            hx.push_back(x);
+            hy.push_back(y);
+        }
+    }
+    int n = hx.size();
+    Point target{3, 2};
+
+    std::vector<Sint16> dist(n);
+    hexDistances(target, hx.data(), hy.data(), n, dist.data());
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(dist[i], hexDist(target, {hx[i], hy[i]}));
+    }
+
+    std::vector<Sint16> nx(n), ny(n);
+    for (auto d : Dir()) {
+        hexNeighbors(hx.data(), hy.data(), n, d, nx.data(), ny.data());
+        for (int i = 0; i < n; ++i) {
+            BOOST_CHECK_EQUAL(str(Point{nx[i], ny[i]}),
+                              str(adjacent({hx[i], hy[i]}, d)));
+        }
+    }
+}
+
+// The array version must pick the same hex as the Point version, including
+// ties (first one wins) and invalid hexes (never chosen).
+BOOST_AUTO_TEST_CASE(Find_Closest)
+{
+    std::minstd_rand gen(5);
+    std::uniform_int_distribution<Sint16> coord(-1, 40);
+    for (int n = 0; n < 40; ++n) {
+        std::vector<Point> hexes;
+        std::vector<Sint16> hx, hy;
+        for (int i = 0; i < n; ++i) {
+            Point hex = (i % 7 == 3) ? hInvalid : Point{coord(gen), coord(gen)};
+            hexes.push_back(hex);
+            hx.push_back(hex.first);
+            hy.push_back(hex.second);
+        }
+
+        for (int t = 0; t < 20; ++t) {
+            Point target{coord(gen), coord(gen)};
+            BOOST_CHECK_EQUAL(findClosest(target, hx.data(), hy.data(), n),
+                              findClosest(target, hexes));
+        }
+    }
+
+    std::vector<Sint16> invalid(9, Sint16_min);
+    BOOST_CHECK_EQUAL(findClosest({0, 0}, invalid.data(), invalid.data(), 9),
+                      -1);
+}